@@ -12,5 +12,5 @@ Config::Config()
 	block   ("b",    desc("Block size"),          init(    1)),
 	dump    ("dump", desc("Dump BVH Tree"),       init(false)),
 	outfile ("out",  desc("Output file"),         init(std::string("image.ppm"))),
-	papi    ("papi", desc("Activate PAPI"),       init(false))
+	papi    ("papi", desc("PAPI events to count while casting rays, separated by commas"), init(std::string("")))
 { }
\ No newline at end of file
@@ -1,6 +1,5 @@
 #include <iostream>
 
-#include "Completeness.h"
 #include <Galois/Accumulator.h>
 
 #include "Rng.h"
@@ -35,9 +34,6 @@ struct CastRays {
 	// how many rays left to process
 	Galois::GAccumulator<uint>& accum;
 
-	// cache misses accumulator
-	Galois::GAccumulator<long long int>& counter_accum;
-	// Galois::GAccumulator<long long int> * const counter_accum;
 
 	// whats the depth of the current rays?
 	const uint depth;
@@ -55,8 +51,6 @@ struct CastRays {
 				RayList& _rays,
 				const Config& _config,
 				Galois::GAccumulator<uint>& _accum,
-				Galois::GAccumulator<long long int>& _counter_accum,
-				// Galois::GAccumulator<long long int> * const _counter_accum,
 				const uint _depth,
 				std::vector<RNG>& _rngs)
 	:	cam(_cam),
@@ -66,7 +60,6 @@ struct CastRays {
 		rays(_rays),
 		config(_config),
 		accum(_accum),
-		counter_accum(_counter_accum),
 		depth(_depth),
 		rngs(_rngs)
 	{ }
@@ -98,37 +91,7 @@ struct CastRays {
 
 		uint rays_disabled = 0;
 
-		int papi_set = PAPI_NULL;
-		long long int value;
-		if (config.papi) {
-#ifndef NDEBUG
-			assert(PAPI_create_eventset(&papi_set) == PAPI_OK);
-			assert(PAPI_add_event(papi_set, PAPI_L2_DCM) == PAPI_OK);
-			assert(PAPI_start(papi_set) == PAPI_OK);
-#else
-			int event;
-			char * name = "LLC_MISSES";
-			PAPI_event_name_to_code(name, &event);
-			PAPI_create_eventset(&papi_set);
-			PAPI_add_event(papi_set, event);
-			PAPI_start(papi_set);
-#endif
-		}
 		bool intersected = tree->intersect(blockStart, blockSize, colisions);
-		if (config.papi) {
-#ifndef NDEBUG
-			assert(PAPI_stop(papi_set, &value) == PAPI_OK);
-			counter_accum.get() += value;
-			assert(PAPI_cleanup_eventset(papi_set) == PAPI_OK);
-			assert(PAPI_destroy_eventset(&papi_set) == PAPI_OK);
-#else
-			PAPI_stop(papi_set, &value);
-			counter_accum.get() += value;
-			PAPI_cleanup_eventset(papi_set);
-			PAPI_destroy_eventset(&papi_set);
-#endif
-		}
-
 		// if miss, return black
 		if (!intersected) {
 			// std::cout << "ahah fuck you and your cousin" << std::endl;
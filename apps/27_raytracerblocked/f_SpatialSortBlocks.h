@@ -1,22 +1,25 @@
 #ifndef _SPATIAL_SORT_BLOCKS_H
 #define _SPATIAL_SORT_BLOCKS_H
 
-#include <CGAL/spatial_sort.h>
+#include <Galois/SpatialSort.h>
 #include "sorting_traits.h"
 
+typedef GaloisRuntime::PerCPU<Galois::SpatialSorter> SpatialSorters;
+
 /**
- * Clamps given vectors to values in the [0, 1] range
+ * Sorts the rays of each block by direction
  */
 struct SpatialSortBlocks {
 	// Optimize runtime for no conflict case
 	typedef int tt_does_not_need_aborts;
 
-	SpatialRayDirSortingTraits sort_dir_traits;
-
 	RayList& rays;
 
-	SpatialSortBlocks(RayList& _rays)
-		: rays(_rays) { }
+	// one sorter per thread, so that buffers are reused across blocks
+	SpatialSorters& sorters;
+
+	SpatialSortBlocks(RayList& _rays, SpatialSorters& _sorters)
+		: rays(_rays), sorters(_sorters) { }
 
 	/**
 	 * Functor
@@ -28,8 +31,8 @@ struct SpatialSortBlocks {
 		RayList::iterator begin = rays.begin() + block.first;
 		RayList::iterator end = rays.begin() + block.second;
 
-		CGAL::spatial_sort(begin, end, sort_dir_traits);
+		sorters.get()(begin, end, RayDirCoordinates());
 	}
 };
 
-#endif // _SPATIAL_SORT_BLOCKS_H
\ No newline at end of file
+#endif // _SPATIAL_SORT_BLOCKS_H
@@ -10,8 +10,7 @@
 #include "Galois/Galois.h"
 #include "Galois/Statistic.h"
 #include "Lonestar/BoilerPlate.h"
-
-#include "papi.h"
+#include "Galois/Runtime/PerfCounters.h"
 
 
 /** clamps a value between 0 and 1 */
@@ -3,14 +3,12 @@
 
 #include <vector>
 #include <fstream>
+#include <sstream>
 #include <Galois/Accumulator.h>
-#include <CGAL/spatial_sort.h>
+#include <Galois/SpatialSort.h>
+#include <Galois/Runtime/Progress.h>
 #include "sorting_traits.h"
 
-inline unsigned long getThreadId() {
-	return GaloisRuntime::LL::getTID();
-}
-
 template<typename T>
 struct Deref : public std::unary_function<T, T*> {
 	T* operator()(T& item) const { return &item; }
@@ -80,22 +78,14 @@ struct Scene {
 
 		RayList rays(config.spp);
 		BlockList blocks;
-		SpatialRayOriginSortingTraits sort_origin_traits;
+		Galois::SpatialSorter origin_sorter;
+		SpatialSorters block_sorters;
 		vector<RNG> rngs(numThreads);
 
-		//	PAPI preparation
-		Galois::GAccumulator<long long> counter_accum;
-		counter_accum.reset(0);
-		if (config.papi) {
+		//	PAPI preparation, one event set per thread
+		GaloisRuntime::PerfCounters counters(config.papi, "CastRays");
+		if (counters.enabled())
 			std::cout << "Using PAPI" << std::endl;
-#ifndef NDEBUG
-			assert(PAPI_library_init(PAPI_VER_CURRENT) == PAPI_VER_CURRENT);
-			assert(PAPI_thread_init(getThreadId) == PAPI_OK);
-#else
-			PAPI_library_init(PAPI_VER_CURRENT);
-			PAPI_thread_init(getThreadId);
-#endif
-		}
 
 		Galois::for_each(wrap(rngs.begin()), wrap(rngs.end()), InitRNG());
 
@@ -109,6 +99,10 @@ struct Scene {
 		}
 		
 		// 3. Main loop - for each pixel
+		std::ostringstream label;
+		label << "Rendering (" << config.spp * 4 << " spp) pixel";
+		GaloisRuntime::Progress progress(label.str());
+		progress.start(img.size());
 		T_fullLoop.start();
 		for(uint p = 0; p < img.size(); ++p) {
 			Pixel& pixel = img.pixels[p];
@@ -125,13 +119,15 @@ struct Scene {
 
 				// 3.2.1. Globally sort all rays
 				T_sort.start();
-				CGAL::spatial_sort(rays.begin(), rays.end(), sort_origin_traits);
+				origin_sorter(rays.begin(), rays.end(), RayOriginCoordinates());
 				// 2.3.2. Locally sort each block of rays
-				Galois::for_each(wrap(blocks.begin()), wrap(blocks.end()), SpatialSortBlocks(rays));
+				Galois::for_each(wrap(blocks.begin()), wrap(blocks.end()), SpatialSortBlocks(rays, block_sorters));
 				T_sort.stop();
 
 				// 2.3.3. Cast'em all
-				Galois::for_each(wrap(blocks.begin()), wrap(blocks.end()), CastRays(cam, tree, img, pixel, rays, config, accum, counter_accum, depth, rngs));
+				counters.start();
+				Galois::for_each(wrap(blocks.begin()), wrap(blocks.end()), CastRays(cam, tree, img, pixel, rays, config, accum, depth, rngs));
+				counters.stop();
 				
 				depth++;
 			}
@@ -146,16 +142,17 @@ struct Scene {
 			//Galois::GAccumulator<double> pixel_x;
 			//Galois::GAccumulator<double> pixel_x;
 
-			std::cerr << "\rRendering (" << config.spp * 4 << " spp) " << (100.0 * p / (img.size())) << '%';
+			progress.tick();
 		}
 		T_fullLoop.stop();
+		progress.stop();
 
 		Galois::for_each(wrap(img.pixels.begin()), wrap(img.pixels.end()), ClampImage());
 
-		if (config.papi) {
-			std::cout << "\n\nPAPI Value: " << counter_accum.get() << std::endl;
-			PAPI_shutdown();
-		}
+		if (counters.enabled())
+			std::cout << "\n" << std::endl;
+		for (unsigned i = 0; i < counters.size(); ++i)
+			std::cout << "PAPI " << counters.name(i) << ": " << counters.total(i) << std::endl;
 	}
 
 	/** save image to file */
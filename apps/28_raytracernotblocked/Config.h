@@ -15,7 +15,7 @@ struct Config {
 	opt<uint>   block;
 	opt<uint>   dump;
 	opt<std::string> outfile;
-	opt<bool>	papi;
+	opt<std::string>	papi;
 	opt<bool>	sort;
 
 	Config();
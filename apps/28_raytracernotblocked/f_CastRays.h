@@ -1,6 +1,5 @@
 #include <iostream>
 
-#include "Completeness.h"
 #include <Galois/Accumulator.h>
 
 #include "Rng.h"
@@ -32,8 +31,6 @@ struct CastRays {
 	// how many rays left to process
 	Galois::GAccumulator<uint>& accum;
 
-	// cache misses accumulator
-	Galois::GAccumulator<long long int>& counter_accum;
 
 	// whats the depth of the current rays?
 	const uint depth;
@@ -50,7 +47,6 @@ struct CastRays {
 				Pixel& _pixel,
 				const Config& _config,
 				Galois::GAccumulator<uint>& _accum,
-				Galois::GAccumulator<long long int>& _counter_accum,
 				const uint _depth,
 				std::vector<RNG>& _rngs)
 	:	cam(_cam),
@@ -59,7 +55,6 @@ struct CastRays {
 		pixel(_pixel),
 		config(_config),
 		accum(_accum),
-		counter_accum(_counter_accum),
 		depth(_depth),
 		rngs(_rngs)
 	{ }
@@ -86,37 +81,7 @@ struct CastRays {
 		// id of intersected object 
 		Object* obj_ptr;
 
-		int papi_set = PAPI_NULL;
-		long long int value;
-		if (config.papi) {
-#ifndef NDEBUG
-			assert(PAPI_create_eventset(&papi_set) == PAPI_OK);
-			assert(PAPI_add_event(papi_set, PAPI_L2_DCM) == PAPI_OK);
-			assert(PAPI_start(papi_set) == PAPI_OK);
-#else
-			int event;
-			char * name = "LLC_MISSES";
-			PAPI_event_name_to_code(name, &event);
-			PAPI_create_eventset(&papi_set);
-			PAPI_add_event(papi_set, event);
-			PAPI_start(papi_set);
-#endif
-		}
 		bool intersected = tree->intersect(ray, dist, obj_ptr);
-		if (config.papi) {
-#ifndef NDEBUG
-			assert(PAPI_stop(papi_set, &value) == PAPI_OK);
-			counter_accum.get() += value;
-			assert(PAPI_cleanup_eventset(papi_set) == PAPI_OK);
-			assert(PAPI_destroy_eventset(&papi_set) == PAPI_OK);
-#else
-			PAPI_stop(papi_set, &value);
-			counter_accum.get() += value;
-			PAPI_cleanup_eventset(papi_set);
-			PAPI_destroy_eventset(&papi_set);
-#endif		
-		}
-
 		// if miss, return black
 		if (!intersected) {
 			ray.valid = false;
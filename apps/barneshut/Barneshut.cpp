@@ -31,36 +31,42 @@ using std::string;
 #include <strings.h>
 #include <boost/math/constants/constants.hpp>
 #include <boost/iterator/transform_iterator.hpp>
+#include <boost/iterator/counting_iterator.hpp>
 #include "Galois/Galois.h"
 #include "Galois/Statistic.h"
+#include "Galois/SpatialSort.h"
 #include "llvm/Support/CommandLine.h"
 #include "Lonestar/BoilerPlate.h"
-
-#include <CGAL/spatial_sort.h>
-#include <papi.h>
+#include "Galois/Runtime/PerfCounters.h"
+#include "Galois/Runtime/Progress.h"
 
 #include "config.h"
 
-
-
-struct Completeness {
-	GaloisRuntime::LL::SimpleLock<true> lock;
-	uint val;
-	uint total;
-};
-
-
+#include "NodeArena.h"
 #include "f_BuildOctree.h"
+#include "f_MortonBuildOctree.h"
+#include "f_RefitOctree.h"
 #include "f_ComputeCenterOfMass.h"
 	/** Build blocks of bodies */
 #include "f_BodyBlocksBuild.h"
 	/** Compute Forces was replaced with CleanComputeForces, and later with BlockedComputeForces */
 #include "f_CleanComputeForces.h"
 #include "f_BlockedComputeForces.h"
+#include "LinearOctree.h"
+#include "f_LinearComputeForces.h"
+#include "f_SimdComputeForces.h"
+#include "f_GroupComputeForces.h"
+#include "f_FmmComputeForces.h"
 #include "f_AdvanceBodies.h"
+#include "f_BlockTimesteps.h"
 #include "f_ReduceBoxes.h"
 #include "utilities.h"
-#include "cgal.h"
+#include "sorting_traits.h"
+#include "BodyStore.h"
+#include "CostZones.h"
+#include "ReplicatedTop.h"
+#include "Snapshot.h"
+#include "Trajectory.h"
 
 
 
@@ -73,8 +79,55 @@ static llvm::cl::opt<int> seed("seed", llvm::cl::desc("Random seed"), llvm::cl::
 static llvm::cl::opt<bool> use_sort("sort", llvm::cl::desc("Toggle using sorted bodies."), llvm::cl::init(false));
 static llvm::cl::opt<bool> print_output("out", llvm::cl::desc("Toggle printing the final result."), llvm::cl::init(false));
 static llvm::cl::opt<int> block_size("bs", llvm::cl::desc("Block size"), llvm::cl::init(0));
-static llvm::cl::opt<string> papi_event_name("papi", llvm::cl::desc("Name of the PAPI event to measure."), llvm::cl::init(""));
-static llvm::cl::opt<bool> output("out", llvm::cl::desc("Percentage Output"), llvm::cl::init(false));
+static llvm::cl::opt<string> papi_event_name("papi", llvm::cl::desc("PAPI events to count in the force computation, separated by commas."), llvm::cl::init(""));
+
+enum ForceAlgo { forces_clean, forces_linear, forces_simd, forces_group, forces_fmm };
+static llvm::cl::opt<ForceAlgo> force_algo("forces", llvm::cl::desc("Force computation (ignored with -bs):"),
+	llvm::cl::values(
+		clEnumValN(forces_clean, "clean", "Walk the octree with an explicit stack (default)"),
+		clEnumValN(forces_linear, "linear", "Stackless walk over the flattened octree"),
+		clEnumValN(forces_simd, "simd", "Flattened walk gathering interaction lists for a vector kernel"),
+		clEnumValN(forces_group, "group", "One shared interaction list per octree cell of at most -G bodies"),
+		clEnumValN(forces_fmm, "fmm", "Dual tree walk with cell to cell translations (fast multipole)"),
+		clEnumValEnd),
+	llvm::cl::init(forces_clean));
+static llvm::cl::opt<double> tol("tol", llvm::cl::desc("Opening tolerance, <0.57 to bound error"), llvm::cl::init(0.025));
+static llvm::cl::opt<bool> use_quad("quad", llvm::cl::desc("Toggle quadrupole moments (clean and blocked walks, always on with fmm)."), llvm::cl::init(false));
+enum BuildAlgo { build_insert, build_morton };
+static llvm::cl::opt<BuildAlgo> build_algo("build", llvm::cl::desc("Octree construction:"),
+	llvm::cl::values(
+		clEnumValN(build_insert, "insert", "Concurrent inserts from the root (default)"),
+		clEnumValN(build_morton, "morton", "Parallel build from sorted Morton keys, cells stored contiguously"),
+		clEnumValEnd),
+	llvm::cl::init(build_insert));
+static llvm::cl::opt<unsigned> bucket_size("bucket", llvm::cl::desc("Bodies per octree leaf bucket, up to 8 (insert build)"), llvm::cl::init(1));
+static llvm::cl::opt<double> refit("refit", llvm::cl::desc("Keep the octree across steps, rebuilding it when more than this fraction of the bodies left the cell 5 levels above their leaf (0 rebuilds every step; at the default time step, 0.6 keeps the tree up to a million bodies)"), llvm::cl::init(0.0));
+static llvm::cl::opt<double> refit_growth("refit-growth", llvm::cl::desc("With -refit, also rebuild once the cells per body grew by this factor"), llvm::cl::init(1.25));
+static llvm::cl::opt<bool> use_soa("soa", llvm::cl::desc("Toggle structure of arrays bodies, put in Morton order once (clean walk)."), llvm::cl::init(false));
+enum Schedule { sched_chunked, sched_costzones };
+static llvm::cl::opt<Schedule> schedule("sched", llvm::cl::desc("Force loop scheduling (clean, linear and simd walks):"),
+	llvm::cl::values(
+		clEnumValN(sched_chunked, "chunked", "Bodies in array order, in stolen chunks of 256 (default)"),
+		clEnumValN(sched_costzones, "costzones", "One contiguous zone of the tree per thread, of equal cost in the previous step"),
+		clEnumValEnd),
+	llvm::cl::init(sched_chunked));
+static llvm::cl::opt<unsigned> levels("levels", llvm::cl::desc("Timestep levels, each halving the step (clean, linear and simd walks)"), llvm::cl::init(1));
+static llvm::cl::opt<double> eta("eta", llvm::cl::desc("With -levels, bodies step by at most eta * sqrt(eps / |acc|)"), llvm::cl::init(1.0));
+enum Precision { precision_double, precision_mixed };
+static llvm::cl::opt<Precision> precision("precision", llvm::cl::desc("Interaction precision (simd and group walks):"),
+	llvm::cl::values(
+		clEnumValN(precision_double, "double", "Double throughout (default)"),
+		clEnumValN(precision_mixed, "mixed", "Float interactions relative to the body or group, summed in double"),
+		clEnumValEnd),
+	llvm::cl::init(precision_double));
+static llvm::cl::opt<unsigned> group_size("G", llvm::cl::desc("Maximum bodies per group with -forces=group"), llvm::cl::init(16));
+static llvm::cl::opt<unsigned> replicate("replicate", llvm::cl::desc("Copy the top N levels of the octree to every package for the walks (clean walk)"), llvm::cl::init(0));
+static llvm::cl::opt<string> restart("restart", llvm::cl::desc("Start from the bodies of a snapshot instead of generating them (ignores -n and -seed)"), llvm::cl::init(""));
+static llvm::cl::opt<unsigned> checkpoint_every("checkpoint-every", llvm::cl::desc("Save a snapshot every N time steps"), llvm::cl::init(0));
+static llvm::cl::opt<string> checkpoint_file("checkpoint", llvm::cl::desc("Snapshot written by -checkpoint-every"), llvm::cl::init("barneshut.snap"));
+static llvm::cl::opt<string> trajectory_file("trajectory", llvm::cl::desc("Write the positions to file from a thread of its own, overlapping the next steps"), llvm::cl::init(""));
+static llvm::cl::opt<unsigned> trajectory_every("trajectory-every", llvm::cl::desc("With -trajectory, write every N time steps"), llvm::cl::init(1));
+static llvm::cl::opt<unsigned> trajectory_stride("trajectory-stride", llvm::cl::desc("With -trajectory, write every N-th body by id"), llvm::cl::init(1));
 
 
 namespace Barneshut {
@@ -84,8 +137,6 @@ namespace Barneshut {
 		"Barnes-Hut n-body algorithm\n";
 	const char* url = "barneshut";
 
-	Config config;
-
 	void pointBlockInput(Bodies& bodies, BodyBlocks& body_blocks, int block_size) {
 		body_blocks.clear();
 	}
@@ -107,121 +158,387 @@ namespace Barneshut {
 		}
 
 	void run (int nbodies, int ntimesteps, int seed) {
+		Config config(tol);
 		Bodies bodies;
 		BodyBlocks body_blocks;
-		SpatialBodySortingTraits sst;
-		Completeness comp;
-		comp.val = 0;
-
-		generateInput(bodies, nbodies, seed);
+		Galois::SpatialSorter sorter;
+		NodeArena arena;
+		MortonBuildOctree morton;
+		unsigned bucket = build_algo == build_morton ? 1 : std::min(8u, std::max(1u, (unsigned) bucket_size));
+		NodeArena tree_arena;
+		RefitOctree refitter(&tree_arena, bucket);
+		Galois::Statistic rebuilds("TreeRebuilds");
+		Galois::Statistic moves("RefitMoves");
+		Galois::Statistic evaluations("ForceEvaluations");
+		LinearOctree linear;
+		BodyStore store;
+		CostZones zones;
+		InteractionLists lists;
+		MixedInteractionLists mixed_lists;
+		BlockedComputeForces::Scratches scratches;
+		std::vector<BodyGroup> groups;
+		FmmComputeForces::Scratches fmm_scratches;
+		const char* kernel_name;
+		ForceKernel kernel = selectForceKernel(&kernel_name);
+		MixedForceKernel mixed_kernel = selectMixedForceKernel();
+		GaloisRuntime::Progress comp("finished");
+
+		bool soa = use_soa && block_size <= 0 && force_algo == forces_clean;
+
+		// time steps run before this one, by the runs before a restart.
+		// With -soa, the snapshot's arrays become the body store, so it
+		// stays mapped for the whole run
+		uint64_t steps_before = 0;
+		Snapshot* snapshot = NULL;
+		if (restart.empty()) {
+			generateInput(bodies, nbodies, seed);
+		} else {
+			snapshot = new Snapshot(restart);
+			if (soa)
+				snapshot->load(bodies, store);
+			else
+				snapshot->load(bodies);
+			steps_before = snapshot->step();
+			nbodies = bodies.size();
+		}
 		/*for(int i = 0; i < nbodies; ++i)
 		  std::cout << "body " << i << " " << bodies[i] << std::endl;*/
 
 		typedef GaloisRuntime::WorkList::dChunkedLIFO<256> WL;
 
-		//  Prepare PAPI
-		long long int papi_value = 0;
-		if (!papi_event_name.empty()) {
-			std::cerr << "* Using PAPI to measure counter [" << papi_event_name << "]." << std::endl;
-#ifndef NDEBUG
-			assert(PAPI_library_init(PAPI_VER_CURRENT) == PAPI_VER_CURRENT);
-			assert(PAPI_thread_init(getTID) == PAPI_OK);
-#else
-			int papiVersion = PAPI_library_init(PAPI_VER_CURRENT);
-			if (papiVersion != PAPI_VER_CURRENT)
-				std::cerr << "PAPI_library_init: " << papiVersion << " [" << PAPI_VER_CURRENT << ']' << std::endl;
-			int result = PAPI_thread_init(getTID);
-			if (result != PAPI_OK)
-				std::cerr << "PAPI_thread_init: " << PAPI_strerror(result) << std::endl;
-#endif		
-		}
-
 		//	report activated switches
 		std::cerr << "* Using parallel implementation (Galois) with " << numThreads << " threads." << std::endl;
-		if (use_sort)
+		if (!restart.empty())
+			std::cerr << "* Using snapshot " << restart << " of " << nbodies << " bodies after " << steps_before << " time steps." << std::endl;
+		if (checkpoint_every > 0)
+			std::cerr << "* Using checkpoints to " << checkpoint_file << " every " << checkpoint_every << " time steps." << std::endl;
+		Trajectory* trajectory = NULL;
+		if (!trajectory_file.empty()) {
+			std::cerr << "* Using " << (Trajectory::compressed() ? "compressed " : "") << "trajectory output to " << trajectory_file
+				<< " every " << trajectory_every << " time steps." << std::endl;
+			trajectory = new Trajectory(trajectory_file, nbodies, trajectory_stride);
+		}
+		// the store is filled once, in Morton order, and the bodies stay put
+		bool sort = use_sort && !soa;
+		if (sort)
 			std::cerr << "* Using spatial sorting (bodies)." << std::endl;
+		if (soa)
+			std::cerr << "* Using structure of arrays bodies, sorted once." << std::endl;
+		else if (use_soa)
+			std::cerr << "* Ignoring -soa, only the clean walk reads the body store." << std::endl;
+		if (build_algo == build_morton)
+			std::cerr << "* Using Morton key octree build." << std::endl;
+		if (bucket > 1)
+			std::cerr << "* Using leaf buckets of up to " << bucket << " bodies." << std::endl;
+		else if (bucket_size > 1)
+			std::cerr << "* Ignoring -bucket, only the insert build makes buckets." << std::endl;
+		bool blocksteps = levels > 1 && block_size <= 0 && !soa
+			&& (force_algo == forces_clean || force_algo == forces_linear || force_algo == forces_simd);
+		if (blocksteps)
+			std::cerr << "* Using " << levels << " timestep levels." << std::endl;
+		else if (levels > 1)
+			std::cerr << "* Ignoring -levels, only the clean, linear and simd walks support it (without -soa)." << std::endl;
+		BlockTimesteps timesteps(blocksteps ? levels : 1, config.dtime, eta, config.eps);
+
+		// the octree is kept across steps with -refit, and between the
+		// substeps of a step with -levels
+		bool keep_tree = refit > 0 || blocksteps;
+		if (refit > 0)
+			std::cerr << "* Using octree refit, rebuilding past " << refit << " of the bodies moved." << std::endl;
+		else if (blocksteps)
+			std::cerr << "* Using octree refit between substeps." << std::endl;
 		if (block_size > 0)
 			std::cerr << "* Using point blocking." << std::endl;
+		else if (force_algo == forces_linear)
+			std::cerr << "* Using linearized octree traversal." << std::endl;
+		else if (force_algo == forces_simd)
+			std::cerr << "* Using interaction lists with the " << kernel_name << " kernel." << std::endl;
+		else if (force_algo == forces_group)
+			std::cerr << "* Using group walk with at most " << group_size << " bodies per group and the " << kernel_name << " kernel." << std::endl;
+		else if (force_algo == forces_fmm)
+			std::cerr << "* Using fast multipole method." << std::endl;
+
+		bool mixed = precision == precision_mixed && block_size <= 0
+			&& (force_algo == forces_simd || force_algo == forces_group);
+		if (mixed)
+			std::cerr << "* Using mixed precision interactions." << std::endl;
+		else if (precision == precision_mixed)
+			std::cerr << "* Ignoring -precision=mixed, only the simd and group walks support it." << std::endl;
+
+		bool costzones = schedule == sched_costzones && block_size <= 0 && !soa && !blocksteps
+			&& (force_algo == forces_clean || force_algo == forces_linear || force_algo == forces_simd);
+		if (costzones)
+			std::cerr << "* Using costzones scheduling." << std::endl;
+		else if (schedule == sched_costzones)
+			std::cerr << "* Ignoring -sched=costzones, only the clean, linear and simd walks record costs." << std::endl;
+
+		bool fmm = block_size <= 0 && force_algo == forces_fmm;
+		bool quadrupoles = fmm || (use_quad && (block_size > 0 || force_algo == forces_clean));
+		if (quadrupoles)
+			std::cerr << "* Using quadrupole moments." << std::endl;
+		else if (use_quad)
+			std::cerr << "* Ignoring -quad, only the clean and blocked walks use quadrupoles." << std::endl;
+
+		bool replicated = replicate > 0 && block_size <= 0 && force_algo == forces_clean;
+		ReplicatedTop tops(replicate, &arena);
+		if (replicated)
+			std::cerr << "* Using copies of the top " << replicate << " octree levels on each of "
+				<< GaloisRuntime::LL::getMaxPackageForThread(Galois::getActiveThreads() - 1) + 1 << " packages." << std::endl;
+		else if (replicate > 0)
+			std::cerr << "* Ignoring -replicate, only the clean walk reads the copies." << std::endl;
+		ReplicatedTop* walk_tops = replicated ? &tops : NULL;
+
+		// one event set per thread, counting through step 4 of every time step
+		GaloisRuntime::PerfCounters counters(papi_event_name, "ComputeForces");
+		if (counters.enabled())
+			std::cerr << "* Using PAPI to count [" << papi_event_name << "] in the force computation." << std::endl;
+
+		// with -soa, velocities and accelerations live in the store for the
+		// whole run, and the bodies only serve as the octree's leaves. A
+		// -soa run saves them in store order, so a restart keeps that
+		if (soa && !snapshot) {
+			sorter(bodies.begin(), bodies.end(), BodyCoordinates());
+			store.load(bodies);
+		}
 
 		//
 		// Main loop
 		//
 		Galois::StatTimer tAlgorithm;
-		Galois::GAccumulator<unsigned> tTraversalTotal;
+		Galois::CycleStatistic tTraversalTotal("TraversalTime");
 		tAlgorithm.start();
-		for (int step = 0; step < ntimesteps; step++) {
-
-			// Do tree building sequentially
-			Galois::setActiveThreads(1);
+		// with -levels, every time step is made of substeps of the smallest level
+		for (unsigned step = 0; step < ntimesteps * timesteps.size(); step++) {
+			unsigned sub = step % timesteps.size();
 
 			//
-			// Step 0.1. Body ordering goes here
+			// Step 0.1. Body ordering goes here. A kept octree points to
+			// the bodies' slots, so while it is kept they are only sorted when
+			// it gets rebuilt
 			//
-			if (use_sort)
-				CGAL::spatial_sort(bodies.begin(), bodies.end(), sst);
+			if (sort && !keep_tree)
+				sorter(bodies.begin(), bodies.end(), BodyCoordinates());
 
 			//
 			// Step 0.2. BodyBlocks build
 			//
 			if (block_size > 0)
 				Galois::for_each<WL>(wrap(bodies.begin()), wrap(bodies.end()),
-					BodyBlocksBuild(&body_blocks, block_size));
+					BodyBlocksBuild(&body_blocks, bodies, block_size));
 
 			//
-			// Step 1. Generate a bounding box that contains all points. This is done sequentially
+			// Step 1. Generate a bounding box that contains all points.
+			// Each thread grows its own box, which are merged at loop exit
 			//
-			BoundingBox box;
-			ReduceBoxes reduceBoxes(box);
+			Galois::StatTimer T_build("BuildTime");
+			T_build.start();
+			ReducibleBox boxes;
 			Galois::for_each<WL>(wrap(bodies.begin()), wrap(bodies.end()),
-					ReduceBoxes(box));
-			OctreeInternal* top = new OctreeInternal(box.center());
+					ReduceBoxes(boxes));
+			BoundingBox box = boxes.get();
 
 			//
-			// Step 2. Build the Octree
+			// Step 2. Build the Octree. Bodies are inserted concurrently,
+			// or placed from their sorted Morton keys. With -refit, the
+			// previous tree is fixed up instead while it is good enough.
+			// Between substeps it is always fixed up, as long as the bodies
+			// stay in its root cell; the next full step rebuilds it anyway
 			//
-			Galois::for_each<WL>(wrap(bodies.begin()), wrap(bodies.end()),
-					BuildOctree(top, box.radius()));
-
+			OctreeInternal* top;
+			double max_moved = sub != 0 ? 1.0 : refit;
+			double max_growth = sub != 0 ? std::numeric_limits<double>::infinity() : refit_growth;
+			if (keep_tree && max_moved > 0 && refitter(box, max_moved, max_growth)) {
+				top = refitter.top();
+				moves += refitter.moves();
+			} else {
+				if (keep_tree) {
+					// leave the outer bodies room to move before the next rebuild
+					box.grow(box.radius() * 0.125);
+					tree_arena.reset();
+					if (sort)
+						sorter(bodies.begin(), bodies.end(), BodyCoordinates());
+					rebuilds += 1;
+				}
+				NodeArena& nodes = keep_tree ? tree_arena : arena;
+				if (build_algo == build_morton) {
+					top = morton(bodies, box, &nodes);
+				} else {
+					top = nodes.create<OctreeInternal>(box.center());
+					Galois::for_each<WL>(wrap(bodies.begin()), wrap(bodies.end()),
+							BuildOctree(top, box.radius(), &nodes, bucket));
+				}
+				if (keep_tree)
+					refitter.built(top, box);
+			}
+			// cells are sized after the root cell, not the bodies
+			if (keep_tree)
+				box = refitter.cube();
+			T_build.stop();
 
 			//
-			// Step 3. Compute center of mass for each point of the tree
+			// Step 3. Compute center of mass for each point of the tree.
+			// Subtrees below the top few levels are summarized in parallel
 			//
-			ComputeCenterOfMass computeCenterOfMass(top);
+			Galois::StatTimer T_summarize("SummarizeTime");
+			T_summarize.start();
+			ComputeCenterOfMass computeCenterOfMass(top, quadrupoles ? &arena : NULL);
 			computeCenterOfMass();
 
+			//
+			// Step 3.1. Flatten the tree for the stackless walk
+			//
+			if (block_size <= 0 && force_algo != forces_clean && !fmm)
+				linear.build(top, box.diameter() * box.diameter() * config.itolsq, &bodies[0]);
+
+			//
+			// Step 3.2. Cut the tree into zones of equal cost
+			//
+			if (costzones)
+				zones(top);
+
+			//
+			// Step 3.3. Copy the top of the tree to every package
+			//
+			if (replicated)
+				tops(top);
+			T_summarize.stop();
+
 			// Parallel stuff starts here
 			Galois::StatTimer T_parallel("ParallelTime");
 			T_parallel.start();
-			Galois::setActiveThreads(numThreads);
 
 			//
 			// Step 4. Compute forces for each body
 			//
-			Galois::GAccumulator<long long int> papi_value_total;
-			if (block_size > 0) {
-				comp.total = body_blocks.size();
-				BlockedComputeForces bcf(top, box.diameter(), config.itolsq, config.dthf, config.epssq, &tTraversalTotal, papi_event_name, &papi_value_total, &comp);
+			counters.start();
+			if (blocksteps) {
+				// only the bodies ending their step, leaving the kicks to step 5
+				std::vector<Body*>& active = timesteps.gather(bodies, sub);
+				comp.start(active.size());
+				evaluations += active.size();
+				if (force_algo == forces_linear) {
+					LinearComputeForces lcf(&linear, 0.0, config.epssq, &tTraversalTotal, &comp);
+					Galois::for_each<WL>(active.begin(), active.end(), lcf);
+				} else if (force_algo == forces_simd && mixed) {
+					MixedSimdComputeForces scf(&linear, &mixed_lists, mixed_kernel, 0.0, config.epssq, &tTraversalTotal, &comp);
+					Galois::for_each<WL>(active.begin(), active.end(), scf);
+				} else if (force_algo == forces_simd) {
+					SimdComputeForces scf(&linear, &lists, kernel, 0.0, config.epssq, &tTraversalTotal, &comp);
+					Galois::for_each<WL>(active.begin(), active.end(), scf);
+				} else {
+					CleanComputeForces ccf(top, box.diameter(), config.itolsq, 0.0, config.epssq, &tTraversalTotal, &comp, NULL, walk_tops);
+					Galois::for_each<WL>(active.begin(), active.end(), ccf);
+				}
+			} else if (block_size > 0) {
+				comp.start(body_blocks.size());
+				BlockedComputeForces bcf(&scratches, top, box.diameter(), config.itolsq, config.dthf, config.epssq, &tTraversalTotal, &comp);
 				Galois::for_each<WL>(wrap(body_blocks.begin()), wrap(body_blocks.end()), bcf);
+			} else if (force_algo == forces_linear) {
+				comp.start(bodies.size());
+				LinearComputeForces lcf(&linear, config.dthf, config.epssq, &tTraversalTotal, &comp);
+				if (costzones)
+					zones.run(lcf);
+				else
+					Galois::for_each<WL>(wrap(bodies.begin()), wrap(bodies.end()), lcf);
+			} else if (force_algo == forces_simd && mixed) {
+				comp.start(bodies.size());
+				MixedSimdComputeForces scf(&linear, &mixed_lists, mixed_kernel, config.dthf, config.epssq, &tTraversalTotal, &comp);
+				if (costzones)
+					zones.run(scf);
+				else
+					Galois::for_each<WL>(wrap(bodies.begin()), wrap(bodies.end()), scf);
+			} else if (force_algo == forces_simd) {
+				comp.start(bodies.size());
+				SimdComputeForces scf(&linear, &lists, kernel, config.dthf, config.epssq, &tTraversalTotal, &comp);
+				if (costzones)
+					zones.run(scf);
+				else
+					Galois::for_each<WL>(wrap(bodies.begin()), wrap(bodies.end()), scf);
+			} else if (force_algo == forces_group) {
+				GroupCollector(group_size, groups)(top);
+				comp.start(groups.size());
+				if (mixed) {
+					MixedGroupComputeForces gcf(&linear, &mixed_lists, mixed_kernel, config.dthf, config.epssq, &tTraversalTotal, &comp);
+					Galois::for_each<WL>(groups.begin(), groups.end(), gcf);
+				} else {
+					GroupComputeForces gcf(&linear, &lists, kernel, config.dthf, config.epssq, &tTraversalTotal, &comp);
+					Galois::for_each<WL>(groups.begin(), groups.end(), gcf);
+				}
+			} else if (fmm) {
+				comp.start(top->size - top->nbodies);
+				FmmComputeForces fcf(&arena, &fmm_scratches, config.itolsq, config.dthf, config.epssq, &tTraversalTotal, &comp);
+				fcf(top, box.diameter());
+			} else if (soa) {
+				comp.start(bodies.size());
+				CleanComputeForces ccf(top, box.diameter(), config.itolsq, config.dthf, config.epssq, &tTraversalTotal, &comp, &store, walk_tops);
+				Galois::for_each<WL>(boost::counting_iterator<uint32_t>(0), boost::counting_iterator<uint32_t>(store.size()), ccf);
 			} else {
-				comp.total = bodies.size();
-				CleanComputeForces ccf(top, box.diameter(), config.itolsq, config.dthf, config.epssq, &tTraversalTotal, papi_event_name, &papi_value_total, &comp);
-				Galois::for_each<WL>(wrap(bodies.begin()), wrap(bodies.end()), ccf);
+				comp.start(bodies.size());
+				CleanComputeForces ccf(top, box.diameter(), config.itolsq, config.dthf, config.epssq, &tTraversalTotal, &comp, NULL, walk_tops);
+				if (costzones)
+					zones.run(ccf);
+				else
+					Galois::for_each<WL>(wrap(bodies.begin()), wrap(bodies.end()), ccf);
 			}
-			papi_value = papi_value_total.get();
+			counters.stop();
+			comp.stop();
+
+			if (!blocksteps)
+				evaluations += bodies.size();
 
 			//
 			// Step 5. Update body positions
 			//
-			//Galois::for_each<WL>(wrap(bodies.begin()), wrap(bodies.end()),
-			//		AdvanceBodies(config.dthf, config.dtime));
+			if (blocksteps) {
+				std::vector<Body*>& active = timesteps.gather(bodies, sub);
+				Galois::for_each<WL>(active.begin(), active.end(),
+						BlockTimesteps::Kick(&timesteps, sub, step == 0 && steps_before == 0));
+				Galois::for_each<WL>(wrap(bodies.begin()), wrap(bodies.end()),
+						BlockTimesteps::Drift(timesteps.dt(levels - 1)));
+			} else if (soa) {
+				Galois::for_each<WL>(boost::counting_iterator<uint32_t>(0), boost::counting_iterator<uint32_t>(store.size()),
+						AdvanceBodies(config.dthf, config.dtime, &store));
+			} else {
+				Galois::for_each<WL>(wrap(bodies.begin()), wrap(bodies.end()),
+						AdvanceBodies(config.dthf, config.dtime));
+			}
 			T_parallel.stop();
 
 			// std::cout 
 			// 	<< "Timestep " << step
 			// 	<< " Center of Mass = " << top->pos << "\n";
-			delete top;
+			// drop the whole tree at once (only this step's moments with -refit),
+			// keeping its pages for the next step
+			arena.reset();
+
+			//
+			// Step 6. Save a snapshot after every -checkpoint-every time steps
+			//
+			unsigned done = step / timesteps.size() + 1;
+			if (checkpoint_every > 0 && sub + 1 == timesteps.size() && done % checkpoint_every == 0) {
+				Galois::StatTimer T_checkpoint("CheckpointTime");
+				T_checkpoint.start();
+				if (soa)
+					store.save(bodies);
+				Snapshot::save(checkpoint_file, bodies, steps_before + done);
+				// a run restarted from here builds a new tree, so this one does too
+				refitter.drop();
+				T_checkpoint.stop();
+			}
+
+			//
+			// Step 6.1. Hand the positions to the trajectory writer
+			//
+			if (trajectory && sub + 1 == timesteps.size() && done % std::max(1u, (unsigned) trajectory_every) == 0) {
+				Galois::StatTimer T_trajectory("TrajectoryTime");
+				T_trajectory.start();
+				trajectory->write(bodies, steps_before + done);
+				T_trajectory.stop();
+			}
 		}
 		tAlgorithm.stop();
+		// waits for the last frames
+		delete trajectory;
 
 		if (print_output) {
 			std::cout << std::endl << "Final positions:" << std::endl;
@@ -229,15 +546,13 @@ namespace Barneshut {
 				std::cout << i << ", " << bodies[i].pos << std::endl;
 			}
 		}
+		delete snapshot;
 
 		std::cerr << '\t' << (double) tAlgorithm.get_usec() * 1e-6 << " seconds" << std::endl;
-		std::cerr << '\t' << (double) tTraversalTotal.get() * 1e-3 / (nbodies * ntimesteps) << " miliseconds" << std::endl;
+		std::cerr << '\t' << (double) tTraversalTotal.get_usec() * 1e-3 / (nbodies * ntimesteps) << " miliseconds" << std::endl;
 
-		//	Cleanup PAPI
-		if (!papi_event_name.empty()) {
-			std::cerr << "- " << papi_event_name << ":\t" << papi_value << std::endl;
-			PAPI_shutdown();
-		}
+		for (unsigned i = 0; i < counters.size(); ++i)
+			std::cerr << "- " << counters.name(i) << ":\t" << counters.total(i) << std::endl;
 	}
 
 } // end namespace
@@ -0,0 +1,139 @@
+#ifndef ___BODY_STORE_H___
+#define ___BODY_STORE_H___
+
+#include <stdint.h>
+
+#include <Galois/Galois.h>
+#include <Galois/Runtime/mm/Mem.h>
+
+#include "Octree.h"
+#include "utilities.h"
+
+namespace Barneshut {
+
+/**
+ * Structure of arrays storage of a Bodies vector, one 64 byte aligned array
+ * per field, body i of the store being bodies[i].
+ *
+ * Once loaded, the store holds the velocities and accelerations; the Body
+ * objects stay in place as the octree's leaves, and only their positions
+ * are kept current, by AdvanceBodies. A walk turns a leaf into its index
+ * from the address alone and reads the store instead. With the bodies in
+ * Morton order, the leaves of a cell are neighbors in every array.
+ */
+class BodyStore {
+  static const size_t Align = 64;
+  static const unsigned Fields = 10;
+
+  char* block;
+  size_t bytes;
+  size_t n;
+  uintptr_t base;
+
+  // copies a block of bodies in (load) or out (!load)
+  struct Copy {
+    BodyStore* store;
+    Bodies* bodies;
+    bool load;
+    Copy(BodyStore* _store, Bodies* _bodies, bool _load) : store(_store), bodies(_bodies), load(_load) { }
+    void operator()(unsigned tid, unsigned num) {
+      BodyStore& s = *store;
+      size_t end = s.n * (tid + 1) / num;
+      for (size_t i = s.n * tid / num; i < end; ++i) {
+        Body& b = (*bodies)[i];
+        if (load) {
+          s.x[i] = b.pos.x; s.y[i] = b.pos.y; s.z[i] = b.pos.z;
+          s.mass[i] = b.mass;
+          s.vx[i] = b.vel.x; s.vy[i] = b.vel.y; s.vz[i] = b.vel.z;
+          s.ax[i] = b.acc.x; s.ay[i] = b.acc.y; s.az[i] = b.acc.z;
+        } else {
+          b.pos = Point(s.x[i], s.y[i], s.z[i]);
+          b.vel = Point(s.vx[i], s.vy[i], s.vz[i]);
+          b.acc = Point(s.ax[i], s.ay[i], s.az[i]);
+        }
+      }
+    }
+  };
+
+public:
+  double *x, *y, *z, *mass;
+  double *vx, *vy, *vz;
+  double *ax, *ay, *az;
+
+  BodyStore() : block(NULL), bytes(0), n(0), base(0) { }
+
+  ~BodyStore() {
+    if (block)
+      GaloisRuntime::MM::largeFree(block, bytes);
+  }
+
+  size_t size() const {
+    return n;
+  }
+
+  //! Whether node is one of the stored bodies, without reading it
+  bool contains(const Octree* node) const {
+    return reinterpret_cast<uintptr_t>(node) - base < n * sizeof(Body);
+  }
+
+  uint32_t index(const Octree* leaf) const {
+    return (reinterpret_cast<uintptr_t>(leaf) - base) / sizeof(Body);
+  }
+
+  Point pos(uint32_t i) const {
+    return Point(x[i], y[i], z[i]);
+  }
+
+  //! The leaf of body i
+  Body& body(uint32_t i) const {
+    return reinterpret_cast<Body*>(base)[i];
+  }
+
+  /**
+   * Copies bodies into the store, growing it when needed. The bodies must
+   * not move while the store is in use
+   */
+  void load(Bodies& bodies) {
+    n = bodies.size();
+    base = reinterpret_cast<uintptr_t>(&bodies[0]);
+
+    // every array starts on its own cache line
+    size_t stride = (n * sizeof(double) + Align - 1) & ~(Align - 1);
+    if (stride * Fields + Align > bytes) {
+      if (block)
+        GaloisRuntime::MM::largeFree(block, bytes);
+      bytes = stride * Fields + Align;
+      block = static_cast<char*>(GaloisRuntime::MM::largeAlloc(bytes));
+    }
+    char* p = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(block) + Align - 1) & ~(Align - 1));
+    double** fields[Fields] = { &x, &y, &z, &mass, &vx, &vy, &vz, &ax, &ay, &az };
+    for (unsigned f = 0; f < Fields; ++f)
+      *fields[f] = reinterpret_cast<double*>(p + f * stride);
+
+    Galois::on_each(Copy(this, &bodies, true));
+  }
+
+  /**
+   * Takes arrays already holding bodies, in the order x to az of the
+   * fields above, as the store instead of copying them. The arrays must
+   * outlive the store, and the bodies must not move
+   */
+  void map(Bodies& bodies, double* const* arrays) {
+    n = bodies.size();
+    base = reinterpret_cast<uintptr_t>(&bodies[0]);
+    double** fields[Fields] = { &x, &y, &z, &mass, &vx, &vy, &vz, &ax, &ay, &az };
+    for (unsigned f = 0; f < Fields; ++f)
+      *fields[f] = arrays[f];
+  }
+
+  /**
+   * Brings the bodies fully up to date, for a snapshot
+   */
+  void save(Bodies& bodies) {
+    Galois::on_each(Copy(this, &bodies, false));
+  }
+};
+
+}
+
+#endif//___BODY_STORE_H___
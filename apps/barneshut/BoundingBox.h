@@ -18,11 +18,11 @@ struct BoundingBox {
   explicit BoundingBox(const Point& p) : min(p), max(p) { }
 
   /**
-   * If not args, box is infinite
+   * If not args, box is empty, so merging anything into it yields that thing
    */
   BoundingBox() :
     min(std::numeric_limits<double>::max()),
-    max(std::numeric_limits<double>::min()) { }
+    max(-std::numeric_limits<double>::max()) { }
 
   /**
    * Given another box, merges both, by giving the smallest boundingBox that wraps both of them
@@ -79,6 +79,16 @@ struct BoundingBox {
     return diameter() / 2;
   }
 
+  /**
+   * Moves every face out by margin
+   */
+  void grow(double margin) {
+    for (int i = 0; i < 3; i++) {
+      min[i] -= margin;
+      max[i] += margin;
+    }
+  }
+
   /**
    * This comment was left empty on purpose
    */
@@ -0,0 +1,158 @@
+#ifndef ___COST_ZONES_H___
+#define ___COST_ZONES_H___
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+#include <Galois/Galois.h>
+
+#include "Octree.h"
+#include "utilities.h"
+
+namespace Barneshut {
+
+/**
+ * Costzones partitioning (Singh et al.): the bodies, taken in the
+ * depth-first order of the octree, are cut into one contiguous zone per
+ * thread, each with about the same total cost. The cost of a body is its
+ * number of interactions in the previous step, which the force walks leave
+ * in Body::cost; bodies not walked yet count as one.
+ *
+ * Neighboring bodies share most of their walk, so a zone also keeps the
+ * part of the tree its thread reads small.
+ */
+class CostZones {
+public:
+  // subtree below the cut, waiting to be listed
+  struct Task {
+    OctreeInternal* node;
+    uint32_t index;
+    Task(OctreeInternal* _node, uint32_t _index) : node(_node), index(_index) { }
+  };
+
+  struct Fill {
+    typedef int tt_does_not_need_aborts;
+    typedef int tt_does_not_need_stats;
+    CostZones* zones;
+    Fill(CostZones* _zones) : zones(_zones) { }
+
+    template<typename Context>
+    void operator()(const Task& t, Context&) {
+      zones->fill(t.node, t.index, ~0u, NULL);
+    }
+  };
+
+private:
+  std::vector<Body*> order;
+  std::vector<uint64_t> prefix; // cost of the bodies before each one
+  std::vector<uint64_t> sums;   // [thread] cost of a block
+  std::vector<size_t> bounds;   // [zone] first body
+
+  // cost prefix, in two passes over one block per thread
+  struct Prefix {
+    CostZones* zones;
+    bool sum;
+    Prefix(CostZones* _zones, bool _sum) : zones(_zones), sum(_sum) { }
+    void operator()(unsigned tid, unsigned num) {
+      CostZones& z = *zones;
+      size_t n = z.order.size();
+      size_t end = n * (tid + 1) / num;
+      uint64_t c = sum ? 0 : z.sums[tid];
+      for (size_t i = n * tid / num; i < end; ++i) {
+        if (!sum)
+          z.prefix[i] = c;
+        c += std::max(1u, z.order[i]->cost);
+      }
+      if (sum)
+        z.sums[tid] = c;
+    }
+  };
+
+  // empty context for operators run outside of for_each
+  struct Context { };
+
+  template<typename FunctionTy>
+  struct Zone {
+    CostZones* zones;
+    FunctionTy fn;
+    Zone(CostZones* _zones, const FunctionTy& _fn) : zones(_zones), fn(_fn) { }
+    void operator()(unsigned tid, unsigned) {
+      CostZones& z = *zones;
+      Context ctx;
+      for (size_t i = z.bounds[tid]; i < z.bounds[tid + 1]; ++i)
+        fn(z.order[i], ctx);
+    }
+  };
+
+  /**
+   * Lists the bodies of node from order[index] on. When tasks is given,
+   * cells at the cutoff depth are queued instead
+   */
+  void fill(OctreeInternal* node, uint32_t index, unsigned levels, std::vector<Task>* tasks) {
+    for (int i = 0; i < 8; ++i) {
+      Octree* child = node->child[i];
+      if (child == NULL)
+        break;
+
+      if (child->isLeaf()) {
+        order[index++] = static_cast<Body*>(child);
+        continue;
+      }
+      OctreeInternal* n = static_cast<OctreeInternal*>(child);
+      if (tasks && levels == 1)
+        tasks->push_back(Task(n, index));
+      else
+        fill(n, index, levels - 1, tasks);
+      index += n->nbodies;
+    }
+  }
+
+public:
+  /**
+   * Cuts the bodies of the tree at top into one zone per thread. Needs the
+   * body counts of ComputeCenterOfMass
+   */
+  void operator()(OctreeInternal* top) {
+    typedef GaloisRuntime::WorkList::dChunkedLIFO<1> WL;
+    unsigned nthreads = Galois::getActiveThreads();
+    order.resize(top->nbodies);
+    prefix.resize(top->nbodies + 1);
+    sums.resize(nthreads);
+
+    std::vector<Task> tasks;
+    fill(top, 0, parallelCutoff(nthreads), &tasks);
+    Galois::for_each<WL>(tasks.begin(), tasks.end(), Fill(this));
+
+    Galois::on_each(Prefix(this, true));
+    uint64_t total = 0;
+    for (unsigned t = 0; t < nthreads; ++t) {
+      uint64_t c = sums[t];
+      sums[t] = total;
+      total += c;
+    }
+    Galois::on_each(Prefix(this, false));
+    prefix[top->nbodies] = total;
+
+    bounds.resize(nthreads + 1);
+    for (unsigned t = 0; t <= nthreads; ++t)
+      bounds[t] = std::lower_bound(prefix.begin(), prefix.end(), total * t / nthreads) - prefix.begin();
+    bounds[nthreads] = top->nbodies;
+  }
+
+  size_t size() const {
+    return order.size();
+  }
+
+  /**
+   * Runs fn(body, ctx) on every body, each thread going through its own zone
+   */
+  template<typename FunctionTy>
+  void run(const FunctionTy& fn) {
+    Galois::on_each(Zone<FunctionTy>(this, fn));
+  }
+};
+
+}
+
+#endif//___COST_ZONES_H___
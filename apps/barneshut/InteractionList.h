@@ -0,0 +1,363 @@
+#ifndef ___INTERACTION_LIST_H___
+#define ___INTERACTION_LIST_H___
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BARNESHUT_X86_KERNELS
+#endif
+
+namespace Barneshut {
+
+/**
+ * Nodes accepted by one force walk, split by coordinate so that the kernel
+ * below can load several interactions at once. Positions are kept relative
+ * to an origin near the bodies being walked, which lets the mixed precision
+ * kernels store them as float without losing the near field.
+ *
+ * Every array is padded up to a multiple of Width with massless entries, so
+ * the kernels never need a remainder loop. The arrays grow as entries are
+ * pushed and keep their size across walks, so a thread's list ends up as
+ * long as its longest walk.
+ */
+template<typename Scalar>
+struct InteractionListOf {
+  // one 512 bit vector
+  static const unsigned Width = 64 / sizeof(Scalar);
+
+  std::vector<Scalar> x, y, z, m;
+  Point origin;
+  unsigned count;
+
+  InteractionListOf() : count(0) { }
+
+  void clear(const Point& _origin = Point()) {
+    origin = _origin;
+    count = 0;
+  }
+
+  //! Doubles the arrays, keeping room for the padding
+  void grow() {
+    size_t n = std::max<size_t>(2 * x.size(), 256 + Width);
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+    m.resize(n);
+  }
+
+  void push(const Point& pos, double mass) {
+    if (count + Width >= x.size())
+      grow();
+    x[count] = pos.x - origin.x;
+    y[count] = pos.y - origin.y;
+    z[count] = pos.z - origin.z;
+    m[count] = mass;
+    ++count;
+  }
+
+  //! p relative to the origin, as the kernels take it
+  Point relative(const Point& p) const {
+    return Point(p.x - origin.x, p.y - origin.y, p.z - origin.z);
+  }
+
+  /**
+   * Pads the list to a multiple of Width and returns the padded length.
+   * Padding sits at the first entry's position, so it never lands on the
+   * body itself
+   */
+  unsigned pad() {
+    unsigned n = count;
+    while (n % Width != 0) {
+      x[n] = x[0];
+      y[n] = y[0];
+      z[n] = z[0];
+      m[n] = 0.0;
+      ++n;
+    }
+    return n;
+  }
+};
+
+typedef InteractionListOf<double> InteractionList;
+typedef InteractionListOf<float> MixedInteractionList;
+
+/**
+ * Sums the softened accelerations of a padded interaction list on the body
+ * at p (relative to the list's origin), adding them to acc
+ */
+template<typename Scalar>
+struct ForceKernelOf {
+  typedef void (*type)(const InteractionListOf<Scalar>& list, unsigned n, const Point& p, double epssq, Point& acc);
+};
+
+typedef ForceKernelOf<double>::type ForceKernel;
+typedef ForceKernelOf<float>::type MixedForceKernel;
+
+inline void forceKernelScalar(const InteractionList& list, unsigned n, const Point& p, double epssq, Point& acc) {
+  double ax = 0.0, ay = 0.0, az = 0.0;
+  for (unsigned i = 0; i < n; ++i) {
+    double dx = list.x[i] - p.x;
+    double dy = list.y[i] - p.y;
+    double dz = list.z[i] - p.z;
+    double dist_sq = dx * dx + dy * dy + dz * dz + epssq;
+    double idr = 1 / sqrt(dist_sq);
+    double scale = list.m[i] * idr * idr * idr;
+    ax += dx * scale;
+    ay += dy * scale;
+    az += dz * scale;
+  }
+  acc.x += ax;
+  acc.y += ay;
+  acc.z += az;
+}
+
+/**
+ * Mixed precision: each interaction is evaluated in float, and the
+ * accelerations are summed in double
+ */
+inline void forceKernelMixedScalar(const MixedInteractionList& list, unsigned n, const Point& p, double epssq, Point& acc) {
+  const float px = p.x, py = p.y, pz = p.z;
+  const float eps = epssq;
+  double ax = 0.0, ay = 0.0, az = 0.0;
+  for (unsigned i = 0; i < n; ++i) {
+    float dx = list.x[i] - px;
+    float dy = list.y[i] - py;
+    float dz = list.z[i] - pz;
+    float dist_sq = dx * dx + dy * dy + dz * dz + eps;
+    float idr = 1 / sqrtf(dist_sq);
+    float scale = list.m[i] * idr * idr * idr;
+    ax += dx * scale;
+    ay += dy * scale;
+    az += dz * scale;
+  }
+  acc.x += ax;
+  acc.y += ay;
+  acc.z += az;
+}
+
+#ifdef BARNESHUT_X86_KERNELS
+/**
+ * 4 interactions per step. The inverse square root starts from the single
+ * precision estimate (about 11.5 bits), and each Newton step in double
+ * doubles the bits: two give about 44.5, not double's 53. That is far below
+ * the error of the opening criterion, so a third step is not worth it
+ */
+__attribute__((target("avx2,fma")))
+inline void forceKernelAVX2(const InteractionList& list, unsigned n, const Point& p, double epssq, Point& acc) {
+  const __m256d px = _mm256_set1_pd(p.x);
+  const __m256d py = _mm256_set1_pd(p.y);
+  const __m256d pz = _mm256_set1_pd(p.z);
+  const __m256d eps = _mm256_set1_pd(epssq);
+  const __m256d half = _mm256_set1_pd(0.5);
+  const __m256d three_halves = _mm256_set1_pd(1.5);
+  __m256d ax = _mm256_setzero_pd();
+  __m256d ay = _mm256_setzero_pd();
+  __m256d az = _mm256_setzero_pd();
+
+  for (unsigned i = 0; i < n; i += 4) {
+    __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(&list.x[i]), px);
+    __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(&list.y[i]), py);
+    __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(&list.z[i]), pz);
+    __m256d d2 = _mm256_fmadd_pd(dx, dx, eps);
+    d2 = _mm256_fmadd_pd(dy, dy, d2);
+    d2 = _mm256_fmadd_pd(dz, dz, d2);
+
+    __m256d idr = _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(d2)));
+    __m256d hd2 = _mm256_mul_pd(half, d2);
+    idr = _mm256_mul_pd(idr, _mm256_fnmadd_pd(hd2, _mm256_mul_pd(idr, idr), three_halves));
+    idr = _mm256_mul_pd(idr, _mm256_fnmadd_pd(hd2, _mm256_mul_pd(idr, idr), three_halves));
+
+    __m256d scale = _mm256_mul_pd(_mm256_loadu_pd(&list.m[i]), _mm256_mul_pd(idr, _mm256_mul_pd(idr, idr)));
+    ax = _mm256_fmadd_pd(dx, scale, ax);
+    ay = _mm256_fmadd_pd(dy, scale, ay);
+    az = _mm256_fmadd_pd(dz, scale, az);
+  }
+
+  double out[3][4];
+  _mm256_storeu_pd(out[0], ax);
+  _mm256_storeu_pd(out[1], ay);
+  _mm256_storeu_pd(out[2], az);
+  acc.x += (out[0][0] + out[0][1]) + (out[0][2] + out[0][3]);
+  acc.y += (out[1][0] + out[1][1]) + (out[1][2] + out[1][3]);
+  acc.z += (out[2][0] + out[2][1]) + (out[2][2] + out[2][3]);
+}
+
+/**
+ * 8 interactions per step, starting from the 14 bit estimate of rsqrt14
+ */
+__attribute__((target("avx512f")))
+inline void forceKernelAVX512(const InteractionList& list, unsigned n, const Point& p, double epssq, Point& acc) {
+  const __m512d px = _mm512_set1_pd(p.x);
+  const __m512d py = _mm512_set1_pd(p.y);
+  const __m512d pz = _mm512_set1_pd(p.z);
+  const __m512d eps = _mm512_set1_pd(epssq);
+  const __m512d half = _mm512_set1_pd(0.5);
+  const __m512d three_halves = _mm512_set1_pd(1.5);
+  __m512d ax = _mm512_setzero_pd();
+  __m512d ay = _mm512_setzero_pd();
+  __m512d az = _mm512_setzero_pd();
+
+  for (unsigned i = 0; i < n; i += 8) {
+    __m512d dx = _mm512_sub_pd(_mm512_loadu_pd(&list.x[i]), px);
+    __m512d dy = _mm512_sub_pd(_mm512_loadu_pd(&list.y[i]), py);
+    __m512d dz = _mm512_sub_pd(_mm512_loadu_pd(&list.z[i]), pz);
+    __m512d d2 = _mm512_fmadd_pd(dx, dx, eps);
+    d2 = _mm512_fmadd_pd(dy, dy, d2);
+    d2 = _mm512_fmadd_pd(dz, dz, d2);
+
+    __m512d idr = _mm512_rsqrt14_pd(d2);
+    __m512d hd2 = _mm512_mul_pd(half, d2);
+    idr = _mm512_mul_pd(idr, _mm512_fnmadd_pd(hd2, _mm512_mul_pd(idr, idr), three_halves));
+    idr = _mm512_mul_pd(idr, _mm512_fnmadd_pd(hd2, _mm512_mul_pd(idr, idr), three_halves));
+
+    __m512d scale = _mm512_mul_pd(_mm512_loadu_pd(&list.m[i]), _mm512_mul_pd(idr, _mm512_mul_pd(idr, idr)));
+    ax = _mm512_fmadd_pd(dx, scale, ax);
+    ay = _mm512_fmadd_pd(dy, scale, ay);
+    az = _mm512_fmadd_pd(dz, scale, az);
+  }
+
+  acc.x += _mm512_reduce_add_pd(ax);
+  acc.y += _mm512_reduce_add_pd(ay);
+  acc.z += _mm512_reduce_add_pd(az);
+}
+/**
+ * 8 mixed precision interactions per step, one Newton step after rsqrt.
+ * Each step's contributions are widened and added in double
+ */
+__attribute__((target("avx2,fma")))
+inline void forceKernelMixedAVX2(const MixedInteractionList& list, unsigned n, const Point& p, double epssq, Point& acc) {
+  const __m256 px = _mm256_set1_ps(p.x);
+  const __m256 py = _mm256_set1_ps(p.y);
+  const __m256 pz = _mm256_set1_ps(p.z);
+  const __m256 eps = _mm256_set1_ps(epssq);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256 three_halves = _mm256_set1_ps(1.5f);
+  __m256d ax = _mm256_setzero_pd();
+  __m256d ay = _mm256_setzero_pd();
+  __m256d az = _mm256_setzero_pd();
+
+  for (unsigned i = 0; i < n; i += 8) {
+    __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(&list.x[i]), px);
+    __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(&list.y[i]), py);
+    __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(&list.z[i]), pz);
+    __m256 d2 = _mm256_fmadd_ps(dx, dx, eps);
+    d2 = _mm256_fmadd_ps(dy, dy, d2);
+    d2 = _mm256_fmadd_ps(dz, dz, d2);
+
+    __m256 idr = _mm256_rsqrt_ps(d2);
+    __m256 hd2 = _mm256_mul_ps(half, d2);
+    idr = _mm256_mul_ps(idr, _mm256_fnmadd_ps(hd2, _mm256_mul_ps(idr, idr), three_halves));
+
+    __m256 scale = _mm256_mul_ps(_mm256_loadu_ps(&list.m[i]), _mm256_mul_ps(idr, _mm256_mul_ps(idr, idr)));
+    __m256 fx = _mm256_mul_ps(dx, scale);
+    __m256 fy = _mm256_mul_ps(dy, scale);
+    __m256 fz = _mm256_mul_ps(dz, scale);
+    ax = _mm256_add_pd(ax, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(fx)), _mm256_cvtps_pd(_mm256_extractf128_ps(fx, 1))));
+    ay = _mm256_add_pd(ay, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(fy)), _mm256_cvtps_pd(_mm256_extractf128_ps(fy, 1))));
+    az = _mm256_add_pd(az, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(fz)), _mm256_cvtps_pd(_mm256_extractf128_ps(fz, 1))));
+  }
+
+  double out[3][4];
+  _mm256_storeu_pd(out[0], ax);
+  _mm256_storeu_pd(out[1], ay);
+  _mm256_storeu_pd(out[2], az);
+  acc.x += (out[0][0] + out[0][1]) + (out[0][2] + out[0][3]);
+  acc.y += (out[1][0] + out[1][1]) + (out[1][2] + out[1][3]);
+  acc.z += (out[2][0] + out[2][1]) + (out[2][2] + out[2][3]);
+}
+
+// float lanes 8 to 15 of v
+__attribute__((target("avx512f")))
+inline __m256 upperHalf(__m512 v) {
+  return _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1));
+}
+
+/**
+ * 16 mixed precision interactions per step, from rsqrt14 and one Newton step
+ */
+__attribute__((target("avx512f")))
+inline void forceKernelMixedAVX512(const MixedInteractionList& list, unsigned n, const Point& p, double epssq, Point& acc) {
+  const __m512 px = _mm512_set1_ps(p.x);
+  const __m512 py = _mm512_set1_ps(p.y);
+  const __m512 pz = _mm512_set1_ps(p.z);
+  const __m512 eps = _mm512_set1_ps(epssq);
+  const __m512 half = _mm512_set1_ps(0.5f);
+  const __m512 three_halves = _mm512_set1_ps(1.5f);
+  __m512d ax = _mm512_setzero_pd();
+  __m512d ay = _mm512_setzero_pd();
+  __m512d az = _mm512_setzero_pd();
+
+  for (unsigned i = 0; i < n; i += 16) {
+    __m512 dx = _mm512_sub_ps(_mm512_loadu_ps(&list.x[i]), px);
+    __m512 dy = _mm512_sub_ps(_mm512_loadu_ps(&list.y[i]), py);
+    __m512 dz = _mm512_sub_ps(_mm512_loadu_ps(&list.z[i]), pz);
+    __m512 d2 = _mm512_fmadd_ps(dx, dx, eps);
+    d2 = _mm512_fmadd_ps(dy, dy, d2);
+    d2 = _mm512_fmadd_ps(dz, dz, d2);
+
+    __m512 idr = _mm512_rsqrt14_ps(d2);
+    __m512 hd2 = _mm512_mul_ps(half, d2);
+    idr = _mm512_mul_ps(idr, _mm512_fnmadd_ps(hd2, _mm512_mul_ps(idr, idr), three_halves));
+
+    __m512 scale = _mm512_mul_ps(_mm512_loadu_ps(&list.m[i]), _mm512_mul_ps(idr, _mm512_mul_ps(idr, idr)));
+    __m512 fx = _mm512_mul_ps(dx, scale);
+    __m512 fy = _mm512_mul_ps(dy, scale);
+    __m512 fz = _mm512_mul_ps(dz, scale);
+    ax = _mm512_add_pd(ax, _mm512_add_pd(_mm512_cvtps_pd(_mm512_castps512_ps256(fx)), _mm512_cvtps_pd(upperHalf(fx))));
+    ay = _mm512_add_pd(ay, _mm512_add_pd(_mm512_cvtps_pd(_mm512_castps512_ps256(fy)), _mm512_cvtps_pd(upperHalf(fy))));
+    az = _mm512_add_pd(az, _mm512_add_pd(_mm512_cvtps_pd(_mm512_castps512_ps256(fz)), _mm512_cvtps_pd(upperHalf(fz))));
+  }
+
+  acc.x += _mm512_reduce_add_pd(ax);
+  acc.y += _mm512_reduce_add_pd(ay);
+  acc.z += _mm512_reduce_add_pd(az);
+}
+#endif
+
+/**
+ * Picks the widest kernel the running CPU supports. name, when given,
+ * receives a label for reporting
+ */
+inline ForceKernel selectForceKernel(const char** name = NULL) {
+  const char* label = "scalar";
+  ForceKernel kernel = forceKernelScalar;
+#ifdef BARNESHUT_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    label = "AVX-512";
+    kernel = forceKernelAVX512;
+  } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    label = "AVX2";
+    kernel = forceKernelAVX2;
+  }
+#endif
+  if (name)
+    *name = label;
+  return kernel;
+}
+
+//! Same choice among the mixed precision kernels
+inline MixedForceKernel selectMixedForceKernel(const char** name = NULL) {
+  const char* label = "scalar";
+  MixedForceKernel kernel = forceKernelMixedScalar;
+#ifdef BARNESHUT_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    label = "AVX-512";
+    kernel = forceKernelMixedAVX512;
+  } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    label = "AVX2";
+    kernel = forceKernelMixedAVX2;
+  }
+#endif
+  if (name)
+    *name = label;
+  return kernel;
+}
+
+}
+
+#endif//___INTERACTION_LIST_H___
@@ -0,0 +1,135 @@
+#ifndef ___LINEAR_OCTREE_H___
+#define ___LINEAR_OCTREE_H___
+
+#include <vector>
+#include <stdint.h>
+
+#include <Galois/Galois.h>
+
+#include "Octree.h"
+#include "utilities.h"
+
+namespace Barneshut {
+
+/**
+ * Node of the flattened octree.
+ * Cells and bodies alike, stored in depth-first order. The children of a
+ * cell follow it directly, and next is the index right past its subtree.
+ * The children of a bucket are all bodies, so an opened bucket is the run
+ * of leaves up to its next.
+ */
+struct LinearNode {
+  Point pos;
+  double mass;
+  double dsq;     // squared distance under which a cell must be opened
+  uint32_t next;  // first node after this subtree
+  uint32_t body;  // index of the body for leaves, NoBody or Bucket for cells
+
+  static const uint32_t NoBody = ~0u;
+  static const uint32_t Bucket = ~0u - 1;
+
+  bool isCell() const { return body >= Bucket; }
+};
+
+/**
+ * Contiguous copy of the octree, laid out so that a force walk is a single
+ * forward loop: either step into a cell (i + 1) or skip over it (next).
+ *
+ * Built after ComputeCenterOfMass, which provides the subtree sizes needed to
+ * place every subtree independently, so the top levels are filled
+ * sequentially and the subtrees below the cut in parallel.
+ */
+struct LinearOctree {
+  // Optimize runtime for no conflict case
+  typedef int tt_does_not_need_aborts;
+  typedef int tt_does_not_need_stats;
+
+  // subtree below the cut, waiting to be copied
+  struct Task {
+    Octree* node;
+    uint32_t index;
+    double dsq;
+    Task(Octree* _node, uint32_t _index, double _dsq) : node(_node), index(_index), dsq(_dsq) { }
+  };
+
+  std::vector<LinearNode> nodes;
+  Body* base;
+  unsigned cutoff;
+
+  LinearOctree() : base(NULL), cutoff(1) { }
+
+  /**
+   * Flattens the tree rooted at top. root_dsq is the opening distance of top,
+   * and base is the first body, used to turn leaves into body indices
+   */
+  void build(OctreeInternal* top, double root_dsq, Body* _base) {
+    typedef GaloisRuntime::WorkList::dChunkedLIFO<1> WL;
+    base = _base;
+    cutoff = parallelCutoff(Galois::getActiveThreads());
+    nodes.resize(top->size);
+
+    std::vector<Task> tasks;
+    fill(top, 0, root_dsq, 0, &tasks);
+    Galois::for_each<WL>(tasks.begin(), tasks.end(), Fill(this));
+  }
+
+  uint32_t size() const {
+    return nodes.size();
+  }
+
+  const LinearNode& operator[](uint32_t index) const {
+    return nodes[index];
+  }
+
+  struct Fill {
+    typedef int tt_does_not_need_aborts;
+    typedef int tt_does_not_need_stats;
+    LinearOctree* tree;
+    Fill(LinearOctree* _tree) : tree(_tree) { }
+
+    template<typename Context>
+    void operator()(const Task& t, Context&) {
+      tree->fill(t.node, t.index, t.dsq, 0, NULL);
+    }
+  };
+
+private:
+  /**
+   * Copies the subtree at node into nodes[index..]. When tasks is given,
+   * subtrees at the cutoff depth are queued instead of being copied
+   */
+  void fill(Octree* node, uint32_t index, double dsq, unsigned depth, std::vector<Task>* tasks) {
+    LinearNode& ln = nodes[index];
+    ln.pos = node->pos;
+    ln.mass = node->mass;
+
+    if (node->isLeaf()) {
+      ln.dsq = 0.0;
+      ln.next = index + 1;
+      ln.body = static_cast<Body*>(node) - base;
+      return;
+    }
+
+    OctreeInternal* cell = static_cast<OctreeInternal*>(node);
+    ln.dsq = dsq;
+    ln.next = index + cell->size;
+    ln.body = cell->bucket ? LinearNode::Bucket : LinearNode::NoBody;
+
+    uint32_t c = index + 1;
+    for (int i = 0; i < 8; ++i) {
+      Octree* child = cell->child[i];
+      if (child == NULL)
+        break;
+
+      if (tasks && depth + 1 == cutoff && !child->isLeaf())
+        tasks->push_back(Task(child, c, dsq * 0.25));
+      else
+        fill(child, c, dsq * 0.25, depth + 1, tasks);
+      c += child->isLeaf() ? 1 : static_cast<OctreeInternal*>(child)->size;
+    }
+  }
+};
+
+}
+
+#endif//___LINEAR_OCTREE_H___
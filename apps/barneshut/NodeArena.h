@@ -0,0 +1,98 @@
+#ifndef ___NODE_ARENA_H___
+#define ___NODE_ARENA_H___
+
+#include <vector>
+#include <new>
+#include <utility>
+
+#include <Galois/Runtime/PerCPU.h>
+#include <Galois/Runtime/mm/Mem.h>
+
+namespace Barneshut {
+
+/**
+ * Per thread bump allocator for octree nodes.
+ *
+ * Pages come from the Galois page pool and stay with the thread that first
+ * used them. reset() only rewinds each thread's cursor, so the next timestep
+ * bumps through the same pages again and no node is ever destroyed one by one.
+ * Requests bigger than a page get a block of their own, dropped at reset().
+ */
+class NodeArena {
+  struct Local {
+    std::vector<char*> pages;
+    std::vector<std::pair<void*, size_t> > large;
+    unsigned next; // next page to bump through
+    char* cur;
+    char* end;
+    Local() : next(0), cur(0), end(0) { }
+  };
+
+  GaloisRuntime::PerCPU<Local> heaps;
+
+  static void freeLarge(Local& h) {
+    for (unsigned j = 0; j < h.large.size(); ++j)
+      GaloisRuntime::MM::largeFree(h.large[j].first, h.large[j].second);
+    h.large.clear();
+  }
+
+  void refill(Local& h) {
+    if (h.next == h.pages.size())
+      h.pages.push_back(static_cast<char*>(GaloisRuntime::MM::pageAlloc()));
+    h.cur = h.pages[h.next++];
+    h.end = h.cur + GaloisRuntime::MM::pageSize;
+  }
+
+public:
+  ~NodeArena() {
+    for (unsigned i = 0; i < heaps.size(); ++i) {
+      std::vector<char*>& pages = heaps.get(i).pages;
+      for (unsigned j = 0; j < pages.size(); ++j)
+        GaloisRuntime::MM::pageFree(pages[j]);
+      freeLarge(heaps.get(i));
+    }
+  }
+
+  void* allocate(size_t size) {
+    // keep every node 16 byte aligned
+    size = (size + 15) & ~static_cast<size_t>(15);
+    Local& h = heaps.get();
+    if (size > GaloisRuntime::MM::pageSize) {
+      void* block = GaloisRuntime::MM::largeAlloc(size);
+      h.large.push_back(std::make_pair(block, size));
+      return block;
+    }
+    if (h.cur + size > h.end)
+      refill(h);
+    void* retval = h.cur;
+    h.cur += size;
+    return retval;
+  }
+
+  template<typename T>
+  T* create() {
+    return new (allocate(sizeof(T))) T();
+  }
+
+  template<typename T, typename A>
+  T* create(const A& arg) {
+    return new (allocate(sizeof(T))) T(arg);
+  }
+
+  /**
+   * Forgets every node allocated so far, keeping the pages for reuse.
+   * Must be called outside of parallel loops
+   */
+  void reset() {
+    for (unsigned i = 0; i < heaps.size(); ++i) {
+      Local& h = heaps.get(i);
+      h.next = 0;
+      h.cur = h.end = 0;
+      freeLarge(h);
+    }
+  }
+};
+
+}
+
+#endif//___NODE_ARENA_H___
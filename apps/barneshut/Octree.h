@@ -5,41 +5,88 @@
 
 namespace Barneshut {
 
-/** Abstract class for an Octree node.
+/** Base class for an Octree node.
  * A node in an octree is either an internal node or a body (leaf).
+ * The kind of node is kept in a flag rather than in a vtable, so nodes carry
+ * no vptr and isLeaf() is a plain load in the traversal loops.
  */
 struct Octree {
   double mass;
   Point pos;
-  virtual ~Octree() { }
-  virtual bool isLeaf() const = 0;
+  bool isLeaf() const {
+    return leaf;
+  }
 
 protected:
-  Octree() : mass(0.0) { }
-  Octree(double _mass) : mass(_mass) { }
+  bool leaf;
+
+  explicit Octree(bool _leaf) : mass(0.0), leaf(_leaf) { }
+  Octree(double _mass, bool _leaf) : mass(_mass), leaf(_leaf) { }
 };
 
 
 
+/** Traceless quadrupole moment of a cell about its center of mass,
+ * sum of m * (3 d d^T - |d|^2 I). Symmetric, so six components are kept.
+ */
+struct Quadrupole {
+  double xx, xy, xz, yy, yz, zz;
+  Quadrupole() : xx(0.0), xy(0.0), xz(0.0), yy(0.0), yz(0.0), zz(0.0) { }
+
+  // adds the moment of mass m at offset d from the center of mass
+  void add(double m, const Point& d) {
+    double d2 = d.x * d.x + d.y * d.y + d.z * d.z;
+    xx += m * (3 * d.x * d.x - d2);
+    xy += m * 3 * d.x * d.y;
+    xz += m * 3 * d.x * d.z;
+    yy += m * (3 * d.y * d.y - d2);
+    yz += m * 3 * d.y * d.z;
+    zz += m * (3 * d.z * d.z - d2);
+  }
+
+  void add(const Quadrupole& q) {
+    xx += q.xx; xy += q.xy; xz += q.xz;
+    yy += q.yy; yz += q.yz; zz += q.zz;
+  }
+
+  /**
+   * Adds the quadrupole term of the acceleration to acc. pos_diff goes from
+   * the body to the center of mass, and idr is the inverse of its length
+   */
+  void accelerate(const Point& pos_diff, double idr, Point& acc) const {
+    const Point& d = pos_diff;
+    double qx = xx * d.x + xy * d.y + xz * d.z;
+    double qy = xy * d.x + yy * d.y + yz * d.z;
+    double qz = xz * d.x + yz * d.y + zz * d.z;
+    double idr2 = idr * idr;
+    double idr5 = idr2 * idr2 * idr;
+    double s = 2.5 * (d.x * qx + d.y * qy + d.z * qz) * idr2;
+    acc.x += (s * d.x - qx) * idr5;
+    acc.y += (s * d.y - qy) * idr5;
+    acc.z += (s * d.z - qz) * idr5;
+  }
+};
+
 /** Internal node in an Octree.
  * These nodes have pointers for at most 8 other nodes. They also have position and mass.
+ * While the tree is built, pos is the geometric center of the cell; once the
+ * center of mass is computed it holds that instead.
+ * A bucket is a cell holding up to 8 bodies in any order, instead of one
+ * per octant. The clean, linear and simd walks sum an opened bucket
+ * directly; to the rest it is an ordinary cell.
+ * They are allocated from a NodeArena and never destroyed individually.
  */
 struct OctreeInternal : Octree {
+  unsigned char octant; // which child of its parent, before the children are compacted
+  bool bucket; // children are bodies, packed from child[0]
   Octree* child[8];
-  Point pos;
-  OctreeInternal(Point _pos) : pos(_pos) {
+  unsigned size; // nodes in this subtree, set along with the center of mass
+  unsigned nbodies; // bodies in this subtree, likewise
+  Quadrupole* quad; // NULL unless quadrupoles are enabled
+  OctreeInternal(Point _pos) : Octree(false), octant(0), bucket(false), size(1), nbodies(0), quad(NULL) {
+    pos = _pos;
     bzero(child, sizeof(*child) * 8);
   }
-  virtual ~OctreeInternal() {
-    for (int i = 0; i < 8; i++) {
-      if (child[i] != NULL && !child[i]->isLeaf()) {
-        delete child[i];
-      }
-    }
-  }
-  virtual bool isLeaf() const {
-    return false;
-  }
 };
 
 /** Leaf node in an Octree. Represents the bodies in the n-body problem.
@@ -47,13 +94,11 @@ struct OctreeInternal : Octree {
  */
 struct Body : Octree {
   int id;
+  unsigned cost; // interactions in the last force computation
+  unsigned level; // timestep of dtime / 2^level, see BlockTimesteps
   Point vel;
   Point acc;
-  Body() { }
-  virtual bool isLeaf() const {
-    return true;
-  }
-
+  Body() : Octree(true), cost(0), level(0) { }
 };
 
 //  Output operator for the leaf octree nodes.
@@ -0,0 +1,79 @@
+#ifndef ___REPLICATED_TOP_H___
+#define ___REPLICATED_TOP_H___
+
+#include <Galois/Galois.h>
+#include <Galois/Runtime/PerThreadStorage.h>
+#include <Galois/Runtime/ll/HWTopo.h>
+
+#include "Octree.h"
+#include "NodeArena.h"
+
+namespace Barneshut {
+
+/**
+ * Copies of the top levels of the octree, one per package.
+ *
+ * Every walk starts by reading the same few cells, which live wherever
+ * the build put them. Here the first thread of each package copies the
+ * cells of the top levels with nodes from its own arena pages, so the
+ * other threads of the package read them locally. Cells below the copied
+ * levels, bodies and quadrupoles stay shared.
+ *
+ * The copies must be made again once the center of mass is computed, and
+ * are dropped along with the arena.
+ */
+class ReplicatedTop {
+  struct Replica {
+    OctreeInternal* top;
+    Replica() : top(NULL) { }
+  };
+
+  GaloisRuntime::PerPackageStorage<Replica> replicas;
+  unsigned levels;
+  NodeArena* arena;
+  OctreeInternal* top;
+
+  struct Copy {
+    ReplicatedTop* self;
+    Copy(ReplicatedTop* _self) : self(_self) { }
+    void operator()(unsigned tid, unsigned) {
+      if (GaloisRuntime::LL::isLeaderForPackage(tid))
+        self->replicas.getLocal()->top = self->copy(self->top, self->levels);
+    }
+  };
+
+  OctreeInternal* copy(OctreeInternal* node, unsigned levels) {
+    OctreeInternal* c = arena->create<OctreeInternal>(*node);
+    if (levels <= 1)
+      return c;
+    for (int i = 0; i < 8; ++i) {
+      Octree* child = node->child[i];
+      if (child == NULL)
+        break;
+      if (!child->isLeaf())
+        c->child[i] = copy(static_cast<OctreeInternal*>(child), levels - 1);
+    }
+    return c;
+  }
+
+public:
+  ReplicatedTop(unsigned _levels, NodeArena* _arena) : levels(_levels), arena(_arena), top(NULL) { }
+
+  /**
+   * Replaces the copies with the top levels of the tree at _top
+   */
+  void operator()(OctreeInternal* _top) {
+    top = _top;
+    Galois::on_each(Copy(this));
+  }
+
+  //! Root of the copy read by the calling thread
+  OctreeInternal* local() {
+    OctreeInternal* r = replicas.getLocal()->top;
+    return r ? r : top;
+  }
+};
+
+}
+
+#endif//___REPLICATED_TOP_H___
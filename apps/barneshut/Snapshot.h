@@ -0,0 +1,236 @@
+#ifndef ___SNAPSHOT_H___
+#define ___SNAPSHOT_H___
+
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <Galois/Galois.h>
+
+#include "Octree.h"
+#include "BodyStore.h"
+#include "utilities.h"
+
+namespace Barneshut {
+
+/**
+ * Binary snapshot of the bodies: a header, then one 64 byte aligned array
+ * per field, in native byte order.
+ *
+ * Snapshots are written in parallel through a shared mapping of the file,
+ * and bodies are loaded in parallel straight from a private mapping,
+ * without reading the file into a buffer first. A body store takes the
+ * arrays of the mapping as they are: only the leaves are copied out, and
+ * the kernel copies a page of the store the first time the run writes to
+ * it (positions, velocities and accelerations, not masses).
+ *
+ * A snapshot is written under a temporary name, synced to disk and only
+ * then renamed, so a run or machine stopped while saving leaves the
+ * previous one.
+ */
+class Snapshot {
+public:
+  static const uint32_t Version = 1;
+  enum Field { X, Y, Z, VX, VY, VZ, AX, AY, AZ, Mass, Id, Level, Fields };
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t fields;
+    uint64_t nbodies;
+    uint64_t step;            // time steps run before the snapshot
+    uint64_t offset[Fields];  // of every array, from the start of the file
+  };
+
+private:
+  static const size_t Align = 64;
+
+  char* mapping;
+  size_t length;
+  const Header* header;
+
+  static void fail(const std::string& file) {
+    perror(("Barneshut::Snapshot " + file).c_str());
+    abort();
+  }
+
+  // header of n bodies, returning the file length
+  static size_t layout(Header& h, uint64_t n, uint64_t step) {
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "BHSNAP", 6);
+    h.version = Version;
+    h.fields = Fields;
+    h.nbodies = n;
+    h.step = step;
+    size_t off = (sizeof(Header) + Align - 1) & ~(Align - 1);
+    for (unsigned f = 0; f < Fields; ++f) {
+      h.offset[f] = off;
+      size_t bytes = n * (f < Id ? sizeof(double) : sizeof(uint32_t));
+      off += (bytes + Align - 1) & ~(Align - 1);
+    }
+    return off;
+  }
+
+  template<typename T>
+  static T* array(char* base, const Header& h, Field f) {
+    return reinterpret_cast<T*>(base + h.offset[f]);
+  }
+
+  enum Mode { Save, Load, LoadLeaves };
+
+  // copies a block of bodies out to the mapping (Save) or in from it; the
+  // leaves of a body store only need positions, masses, ids and levels
+  struct Copy {
+    char* base;
+    const Header* h;
+    Bodies* bodies;
+    Mode mode;
+    Copy(char* _base, const Header* _h, Bodies* _bodies, Mode _mode) : base(_base), h(_h), bodies(_bodies), mode(_mode) { }
+    void operator()(unsigned tid, unsigned num) {
+      double* d[Id];
+      for (unsigned f = 0; f < Id; ++f)
+        d[f] = array<double>(base, *h, Field(f));
+      int32_t* id = array<int32_t>(base, *h, Id);
+      uint32_t* level = array<uint32_t>(base, *h, Level);
+
+      size_t n = h->nbodies;
+      size_t end = n * (tid + 1) / num;
+      for (size_t i = n * tid / num; i < end; ++i) {
+        Body& b = (*bodies)[i];
+        if (mode == Save) {
+          for (int k = 0; k < 3; ++k) {
+            d[X + k][i] = b.pos[k];
+            d[VX + k][i] = b.vel[k];
+            d[AX + k][i] = b.acc[k];
+          }
+          d[Mass][i] = b.mass;
+          id[i] = b.id;
+          level[i] = b.level;
+        } else {
+          b.pos = Point(d[X][i], d[Y][i], d[Z][i]);
+          if (mode == Load) {
+            b.vel = Point(d[VX][i], d[VY][i], d[VZ][i]);
+            b.acc = Point(d[AX][i], d[AY][i], d[AZ][i]);
+          }
+          b.mass = d[Mass][i];
+          b.id = id[i];
+          b.level = level[i];
+        }
+      }
+    }
+  };
+
+public:
+  /**
+   * Maps the snapshot in file, aborting when it cannot be read or is not a
+   * snapshot of this version
+   */
+  explicit Snapshot(const std::string& file) : mapping(NULL), length(0), header(NULL) {
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd == -1)
+      fail(file);
+    struct stat buf;
+    if (fstat(fd, &buf) == -1)
+      fail(file);
+    length = buf.st_size;
+
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;
+#endif
+    void* m = length >= sizeof(Header) ? mmap(0, length, PROT_READ, flags, fd, 0) : MAP_FAILED;
+    if (m == MAP_FAILED)
+      fail(file);
+    close(fd);
+    mapping = static_cast<char*>(m);
+    header = reinterpret_cast<const Header*>(mapping);
+
+    Header h;
+    size_t expected = layout(h, header->nbodies, 0);
+    if (memcmp(header->magic, h.magic, sizeof(h.magic)) != 0 || header->version != Version
+        || header->fields != Fields || expected != length) {
+      fprintf(stderr, "Barneshut::Snapshot %s: not a version %u snapshot\n", file.c_str(), Version);
+      abort();
+    }
+  }
+
+  ~Snapshot() {
+    munmap(mapping, length);
+  }
+
+  size_t size() const {
+    return header->nbodies;
+  }
+
+  uint64_t step() const {
+    return header->step;
+  }
+
+  /**
+   * Replaces bodies with the snapshot's
+   */
+  void load(Bodies& bodies) const {
+    bodies.resize(size());
+    Galois::on_each(Copy(mapping, header, &bodies, Load));
+  }
+
+  /**
+   * Replaces bodies with the snapshot's leaves, in the snapshot's order,
+   * and makes the mapping's arrays their store. The snapshot must outlive
+   * the store
+   */
+  void load(Bodies& bodies, BodyStore& store) {
+    bodies.resize(size());
+    Galois::on_each(Copy(mapping, header, &bodies, LoadLeaves));
+
+    // writable only now: a private writable mapping would have been
+    // populated by copying every page
+    if (mprotect(mapping, length, PROT_READ | PROT_WRITE) == -1)
+      fail("mapping");
+    double* arrays[] = {
+      array<double>(mapping, *header, X), array<double>(mapping, *header, Y), array<double>(mapping, *header, Z),
+      array<double>(mapping, *header, Mass),
+      array<double>(mapping, *header, VX), array<double>(mapping, *header, VY), array<double>(mapping, *header, VZ),
+      array<double>(mapping, *header, AX), array<double>(mapping, *header, AY), array<double>(mapping, *header, AZ),
+    };
+    store.map(bodies, arrays);
+  }
+
+  /**
+   * Writes bodies to file, as they are after step time steps
+   */
+  static void save(const std::string& file, Bodies& bodies, uint64_t step) {
+    Header h;
+    size_t len = layout(h, bodies.size(), step);
+    std::string tmp = file + ".tmp";
+
+    mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+    int fd = open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, mode);
+    if (fd == -1 || ftruncate(fd, len) == -1)
+      fail(tmp);
+    void* m = mmap(0, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (m == MAP_FAILED)
+      fail(tmp);
+    char* base = static_cast<char*>(m);
+    memcpy(base, &h, sizeof(h));
+    Galois::on_each(Copy(base, &h, &bodies, Save));
+
+    // the data must be on disk before the name points to it
+    if (msync(m, len, MS_SYNC) == -1 || fsync(fd) == -1)
+      fail(tmp);
+    if (munmap(m, len) == -1 || close(fd) == -1 || rename(tmp.c_str(), file.c_str()) == -1)
+      fail(file);
+  }
+};
+
+}
+
+#endif//___SNAPSHOT_H___
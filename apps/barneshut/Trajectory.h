@@ -0,0 +1,202 @@
+#ifndef ___TRAJECTORY_H___
+#define ___TRAJECTORY_H___
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+#include <pthread.h>
+#ifdef GALOIS_USE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <Galois/Galois.h>
+
+#include "Octree.h"
+#include "utilities.h"
+
+namespace Barneshut {
+
+/**
+ * Positions of the bodies over time, written by a thread of its own.
+ *
+ * The file starts with a header (magic "BHTRAJ", version, bodies, body
+ * stride, bodies per frame), followed by one frame per call to write: the
+ * time step, then x, y, z as doubles for bodies 0, stride, 2 * stride...
+ * by id. It is gzip compressed when built with zlib.
+ *
+ * Frames go through two buffers: write fills one while the thread
+ * compresses and writes the other, and only waits when the thread is still
+ * busy with the frame before last.
+ */
+class Trajectory {
+  static const uint64_t Version = 1;
+
+  struct Frame {
+    uint64_t step;
+    std::vector<double> pos;
+    bool full;
+  };
+
+  std::string file;
+  unsigned stride;
+  size_t count;
+  Frame frames[2];
+  unsigned next;   // frame filled by the next write
+  bool quit;
+#ifdef GALOIS_USE_ZLIB
+  gzFile out;
+#else
+  FILE* out;
+#endif
+
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t wake;
+
+  void fail() {
+    perror(("Barneshut::Trajectory " + file).c_str());
+    abort();
+  }
+
+  void put(const void* p, size_t bytes) {
+#ifdef GALOIS_USE_ZLIB
+    bool ok = bytes == 0 || gzwrite(out, p, bytes) > 0;
+#else
+    bool ok = fwrite(p, 1, bytes, out) == bytes;
+#endif
+    if (!ok)
+      fail();
+  }
+
+  // copies the positions of a block of bodies to the frame, by id. An id
+  // with no slot in the frame aborts instead of writing past it
+  struct Fill {
+    Trajectory* self;
+    Bodies* bodies;
+    double* pos;
+    Fill(Trajectory* _self, Bodies* _bodies, double* _pos) : self(_self), bodies(_bodies), pos(_pos) { }
+    void operator()(unsigned tid, unsigned num) {
+      size_t n = bodies->size();
+      size_t end = n * (tid + 1) / num;
+      for (size_t i = n * tid / num; i < end; ++i) {
+        Body& b = (*bodies)[i];
+        if (b.id < 0 || b.id / self->stride >= self->count) {
+          fprintf(stderr, "Barneshut::Trajectory %s: body id %d out of range\n", self->file.c_str(), b.id);
+          abort();
+        }
+        if (b.id % self->stride != 0)
+          continue;
+        double* p = pos + 3 * (b.id / self->stride);
+        p[0] = b.pos.x; p[1] = b.pos.y; p[2] = b.pos.z;
+      }
+    }
+  };
+
+  static void* writer(void* arg) {
+    Trajectory& t = *static_cast<Trajectory*>(arg);
+    unsigned f = 0;
+    pthread_mutex_lock(&t.mutex);
+    while (true) {
+      while (!t.frames[f].full && !t.quit)
+        pthread_cond_wait(&t.wake, &t.mutex);
+      if (!t.frames[f].full)
+        break;
+      pthread_mutex_unlock(&t.mutex);
+
+      Frame& frame = t.frames[f];
+      t.put(&frame.step, sizeof(frame.step));
+      t.put(&frame.pos[0], frame.pos.size() * sizeof(double));
+
+      pthread_mutex_lock(&t.mutex);
+      frame.full = false;
+      pthread_cond_broadcast(&t.wake);
+      f ^= 1;
+    }
+    pthread_mutex_unlock(&t.mutex);
+    return 0;
+  }
+
+public:
+  /**
+   * Starts writing the positions of every stride-th of nbodies bodies to file
+   */
+  Trajectory(const std::string& _file, size_t nbodies, unsigned _stride)
+  : file(_file), stride(std::max(1u, _stride)), count((nbodies + stride - 1) / stride), next(0), quit(false)
+  {
+#ifdef GALOIS_USE_ZLIB
+    out = gzopen(file.c_str(), "wb1");
+#else
+    out = fopen(file.c_str(), "wb");
+#endif
+    if (!out)
+      fail();
+
+    char magic[8] = "BHTRAJ";
+    uint64_t header[4] = { Version, nbodies, stride, count };
+    put(magic, sizeof(magic));
+    put(header, sizeof(header));
+
+    for (int f = 0; f < 2; ++f) {
+      frames[f].pos.resize(3 * count);
+      frames[f].full = false;
+    }
+    pthread_mutex_init(&mutex, 0);
+    pthread_cond_init(&wake, 0);
+    if (pthread_create(&thread, 0, writer, this) != 0)
+      fail();
+  }
+
+  //! Writes the frames left and closes the file
+  ~Trajectory() {
+    pthread_mutex_lock(&mutex);
+    quit = true;
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(thread, 0);
+#ifdef GALOIS_USE_ZLIB
+    if (gzclose(out) != Z_OK)
+      fail();
+#else
+    if (fclose(out) != 0)
+      fail();
+#endif
+    pthread_cond_destroy(&wake);
+    pthread_mutex_destroy(&mutex);
+  }
+
+  static bool compressed() {
+#ifdef GALOIS_USE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /**
+   * Hands the positions of bodies after step time steps to the writer
+   */
+  void write(Bodies& bodies, uint64_t step) {
+    Frame& frame = frames[next];
+    pthread_mutex_lock(&mutex);
+    while (frame.full)
+      pthread_cond_wait(&wake, &mutex);
+    pthread_mutex_unlock(&mutex);
+
+    frame.step = step;
+    Galois::on_each(Fill(this, &bodies, &frame.pos[0]));
+
+    pthread_mutex_lock(&mutex);
+    frame.full = true;
+    pthread_cond_broadcast(&wake);
+    pthread_mutex_unlock(&mutex);
+    next ^= 1;
+  }
+};
+
+}
+
+#endif//___TRAJECTORY_H___
@@ -6,10 +6,10 @@ struct Config {
 	const double eps; // potential softening parameter
 	const double tol; // tolerance for stopping recursion, <0.57 to bound error
 	const double dthf, epssq, itolsq;
-	Config() :
+	Config(double _tol = 0.025) :
 		dtime(0.5),
 		eps(0.05),
-		tol(0.025),
+		tol(_tol),
 		dthf(dtime * 0.5),
 		epssq(eps * eps),
 		itolsq(1.0 / (tol * tol))  { }
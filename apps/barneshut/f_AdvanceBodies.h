@@ -2,6 +2,7 @@
 #define ___F_ADVANCE_BODIES_H___
 
 #include "Octree.h"
+#include "BodyStore.h"
 
 namespace Barneshut {
 
@@ -14,10 +15,12 @@ namespace Barneshut {
 
 		double dthf;
 		double dtime;
+		BodyStore* store;
 
-		AdvanceBodies(double _dthf, double _dtime)
+		AdvanceBodies(double _dthf, double _dtime, BodyStore* _store = NULL)
 		: dthf(_dthf)
 		, dtime(_dtime)
+		, store(_store)
 		{ }
 
 		template<typename Context>
@@ -34,6 +37,30 @@ namespace Barneshut {
 				for (int i = 0; i < 3; ++i)
 					b.vel[i] = velh[i] + dvel[i];
 			}
+
+		/**
+		 * Same step for body index of the store, also moving its leaf for
+		 * the next build
+		 */
+		template<typename Context>
+			void operator()(uint32_t index, Context&) {
+				BodyStore& s = *store;
+				double dvx = s.ax[index] * dthf;
+				double dvy = s.ay[index] * dthf;
+				double dvz = s.az[index] * dthf;
+
+				double vhx = s.vx[index] + dvx;
+				double vhy = s.vy[index] + dvy;
+				double vhz = s.vz[index] + dvz;
+
+				s.x[index] += vhx * dtime;
+				s.y[index] += vhy * dtime;
+				s.z[index] += vhz * dtime;
+				s.body(index).pos = s.pos(index);
+				s.vx[index] = vhx + dvx;
+				s.vy[index] = vhy + dvy;
+				s.vz[index] = vhz + dvz;
+			}
 	};
 
 }
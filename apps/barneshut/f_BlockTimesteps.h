@@ -0,0 +1,151 @@
+#ifndef ___F_BLOCK_TIMESTEPS_H___
+#define ___F_BLOCK_TIMESTEPS_H___
+
+#include <vector>
+#include <cmath>
+
+#include <Galois/Galois.h>
+#include <Galois/Runtime/PerCPU.h>
+
+#include "Octree.h"
+#include "utilities.h"
+
+namespace Barneshut {
+
+/**
+ * Hierarchical (block) timesteps.
+ *
+ * Body b moves with a step of dtime / 2^b.level, the level being picked from
+ * its acceleration as eta * sqrt(eps / |acc|). A step of dtime is made of
+ * 2^(levels - 1) substeps of the smallest size; at each substep only the
+ * bodies whose own step ends there get new forces, then a kick closing
+ * their step and another opening the next one, while every body drifts
+ * through the substep with its half kicked velocity (kick-drift-kick).
+ *
+ * A body can only move to a longer step at a substep where that step would
+ * start, so steps of every level stay aligned.
+ */
+class BlockTimesteps {
+	unsigned levels;
+	unsigned substeps;
+	double dtime;
+	double eta;
+	double eps;
+
+	GaloisRuntime::PerCPU<std::vector<Body*> > bags;
+	std::vector<Body*> active;
+
+	// bodies of a block whose step ends at substep sub
+	struct Gather {
+		BlockTimesteps* self;
+		Bodies* bodies;
+		unsigned sub;
+		Gather(BlockTimesteps* _self, Bodies* _bodies, unsigned _sub) : self(_self), bodies(_bodies), sub(_sub) { }
+		void operator()(unsigned tid, unsigned num) {
+			std::vector<Body*>& bag = self->bags.get();
+			size_t n = bodies->size();
+			size_t end = n * (tid + 1) / num;
+			for (size_t i = n * tid / num; i < end; ++i) {
+				Body& b = (*bodies)[i];
+				if (sub % self->stride(b.level) == 0)
+					bag.push_back(&b);
+			}
+		}
+	};
+
+public:
+	/**
+	 * Closes the step of an active body with its new acceleration, picks
+	 * its next level and opens the next step
+	 */
+	struct Kick {
+		// Optimize runtime for no conflict case
+		typedef int tt_does_not_need_aborts;
+		typedef int tt_does_not_need_stats;
+
+		const BlockTimesteps* steps;
+		unsigned sub;
+		bool first;
+
+		Kick(const BlockTimesteps* _steps, unsigned _sub, bool _first) : steps(_steps), sub(_sub), first(_first) { }
+
+		template<typename Context>
+			void operator()(Body* bb, Context&) {
+				Body& b = *bb;
+				double dthf = first ? 0.0 : steps->dt(b.level) * 0.5;
+				b.level = steps->level(b.acc, sub);
+				dthf += steps->dt(b.level) * 0.5;
+				for (int i = 0; i < 3; ++i)
+					b.vel[i] += b.acc[i] * dthf;
+			}
+	};
+
+	//! Moves every body through one substep
+	struct Drift {
+		// Optimize runtime for no conflict case
+		typedef int tt_does_not_need_aborts;
+		typedef int tt_does_not_need_stats;
+
+		double dt;
+
+		Drift(double _dt) : dt(_dt) { }
+
+		template<typename Context>
+			void operator()(Body* bb, Context&) {
+				Body& b = *bb;
+				for (int i = 0; i < 3; ++i)
+					b.pos[i] += b.vel[i] * dt;
+			}
+	};
+
+	BlockTimesteps(unsigned _levels, double _dtime, double _eta, double _eps)
+	: levels(_levels)
+	, substeps(1 << (_levels - 1))
+	, dtime(_dtime)
+	, eta(_eta)
+	, eps(_eps)
+	{ }
+
+	unsigned size() const {
+		return substeps;
+	}
+
+	//! Substeps in one step of level
+	unsigned stride(unsigned level) const {
+		return substeps >> level;
+	}
+
+	double dt(unsigned level) const {
+		return ldexp(dtime, -(int) level);
+	}
+
+	//! Smallest level allowed by acc, and starting a step at substep sub
+	unsigned level(const Point& acc, unsigned sub) const {
+		double a = sqrt(acc.x * acc.x + acc.y * acc.y + acc.z * acc.z);
+		double want = a > 0.0 ? eta * sqrt(eps / a) : dtime;
+		unsigned l = 0;
+		while (l + 1 < levels && dt(l) > want)
+			++l;
+		while (sub % stride(l) != 0)
+			++l;
+		return l;
+	}
+
+	/**
+	 * Bodies whose step ends at substep sub of the current step
+	 */
+	std::vector<Body*>& gather(Bodies& bodies, unsigned sub) {
+		Galois::on_each(Gather(this, &bodies, sub));
+		active.clear();
+		for (unsigned i = 0; i < bags.size(); ++i) {
+			std::vector<Body*>& bag = bags.get(i);
+			active.insert(active.end(), bag.begin(), bag.end());
+			bag.clear();
+		}
+		return active;
+	}
+};
+
+}
+
+#endif//___F_BLOCK_TIMESTEPS_H___
@@ -1,7 +1,9 @@
 #ifndef ___F_BLOCKED_COMPUTE_FORCES_H___
 #define ___F_BLOCKED_COMPUTE_FORCES_H___
 
-#include <Galois/Accumulator.h>
+#include <Galois/Statistic.h>
+#include <Galois/Runtime/Progress.h>
+#include <Galois/Runtime/PerCPU.h>
 
 #include "Octree.h"
 
@@ -11,20 +13,28 @@ struct BlockedComputeForces {
 	// Optimize runtime for no conflict case
 	typedef int tt_does_not_need_aborts;
 
-	// holds a stacked node to process later
+	// holds a stacked node to process later, for the bodies in [begin, end) of the buffer
 	struct Frame {
 		double dist_sq;
 		Octree* node;
-		// BodiesPtr& bodies;
-		BodiesPtr bodies;
-		Frame(BodiesPtr& _bodies, Octree* _node, double _dist_sq) : dist_sq(_dist_sq), node(_node)
-		// , bodies(_bodies)
-		, bodies(_bodies.begin(), _bodies.end())
-		{ }
-
-		// ~Frame() { delete &bodies; }
+		unsigned begin, end;
+		Frame(Octree* _node, double _dist_sq, unsigned _begin, unsigned _end) : dist_sq(_dist_sq), node(_node), begin(_begin), end(_end) { }
 	};
 
+	/**
+	 * Per thread working memory, kept across blocks and timesteps.
+	 * Frames only ever get a prefix of their parent's range, and a frame is
+	 * popped before any frame pushed below it, so partitioning the buffer in
+	 * place never changes the set of bodies seen by a pending frame.
+	 */
+	struct Scratch {
+		BodiesPtr buffer;
+		std::vector<Frame> frames;
+		std::vector<Point> acc;
+	};
+	typedef GaloisRuntime::PerCPU<Scratch> Scratches;
+
+	Scratches* scratches;
 	OctreeInternal* top;
 	double diameter;
 	double root_dsq;
@@ -32,20 +42,16 @@ struct BlockedComputeForces {
 	double dthf;
 	double epssq;
 
-	Galois::GAccumulator<unsigned> * const tTraversalTotal;
-	Completeness* comp;
-
-	std::string papiEventName;
-	Galois::GAccumulator<long long int> * const papiValueTotal;
+	Galois::CycleStatistic * const tTraversalTotal;
+	GaloisRuntime::Progress* comp;
 
-	BlockedComputeForces(OctreeInternal* _top, double _diameter, double itolsq, double _dthf, double _epssq, Galois::GAccumulator<unsigned> * const _tTraversalTotal = NULL, const std::string& _papiEventName = "", Galois::GAccumulator<long long int> * const _papiValueTotal = NULL, Completeness* _comp = NULL)
-	: top(_top)
+	BlockedComputeForces(Scratches* _scratches, OctreeInternal* _top, double _diameter, double itolsq, double _dthf, double _epssq, Galois::CycleStatistic * const _tTraversalTotal = NULL, GaloisRuntime::Progress* _comp = NULL)
+	: scratches(_scratches)
+	, top(_top)
 	, diameter(_diameter)
 	, dthf(_dthf)
 	, epssq(_epssq)
 	, tTraversalTotal(_tTraversalTotal)
-	, papiEventName(_papiEventName)
-	, papiValueTotal(_papiValueTotal)
 	, comp(_comp)
 	{
 		root_dsq = diameter * diameter * itolsq;
@@ -58,118 +64,59 @@ struct BlockedComputeForces {
 	void operator()(BodiesPtr** bb, Context&) {
 		BodiesPtr& bodies = **bb;
 		uint bsize = bodies.size();
-		Point * acc = new Point[bsize];
-
-		Galois::StatTimer tTraversal;
-		tTraversal.start();
+		std::vector<Point>& accs = scratches->get().acc;
+		accs.resize(bsize);
+		Point* acc = &accs[0];
 
-		if (papiEventName.empty()) {
-			// backup previous acceleration and initialize new accel to 0
-			for(uint j = 0; j < bsize; ++j) {
-				Body& body = *bodies[j];
-
-				acc[j] = body.acc;
-
-				for(int i = 0; i < 3; ++i)
-					body.acc[i] = 0;
-			}
-
-			// compute acceleration for this body
-			iterate(bodies, root_dsq);
-
-			// compute new velocity
-			for(uint j = 0; j < bsize; ++j) {
-				Body& body = *bodies[j];
-				for(int i = 0; i < 3; ++i)
-					body.vel[i] += (body.acc[i] - acc[j][i]) * dthf;
-			}
-		} else {
-			int event;
-			char * name = strdup(papiEventName.c_str());
-#ifndef NDEBUG
-			assert(PAPI_event_name_to_code(name, &event) == PAPI_OK);
-			free(name);
-
-			int eventSet = PAPI_NULL;
-			assert(PAPI_create_eventset(&eventSet) == PAPI_OK);
-			assert(PAPI_add_event(eventSet, event) == PAPI_OK);
-
-			long long int value;
-			assert(PAPI_start(eventSet) == PAPI_OK);
-#else
-			PAPI_event_name_to_code(name, &event);
-			free(name);
-
-			int eventSet = PAPI_NULL;
-			PAPI_create_eventset(&eventSet);
-			PAPI_add_event(eventSet, event);
-
-			long long int value;
-			PAPI_start(eventSet);
-#endif
-
-			// backup previous acceleration and initialize new accel to 0
-			for(uint j = 0; j < bsize; ++j) {
-				Body& body = *bodies[j];
-
-				acc[j] = body.acc;
-
-				for(int i = 0; i < 3; ++i)
-					body.acc[i] = 0;
-			}
+		unsigned long long tTraversal = Galois::readTSC();
 
-			// compute acceleration for this body
-			iterate(bodies, root_dsq);
+		// backup previous acceleration and initialize new accel to 0
+		for(uint j = 0; j < bsize; ++j) {
+			Body& body = *bodies[j];
 
-			// compute new velocity
-			for(uint j = 0; j < bsize; ++j) {
-				Body& body = *bodies[j];
-				for(int i = 0; i < 3; ++i)
-					body.vel[i] += (body.acc[i] - acc[j][i]) * dthf;
-			}
+			acc[j] = body.acc;
 
-#ifndef NDEBUG
-			assert(PAPI_stop(eventSet, &value) == PAPI_OK);
-			papiValueTotal->get() += value;
+			for(int i = 0; i < 3; ++i)
+				body.acc[i] = 0;
+		}
 
-			assert(PAPI_cleanup_eventset(eventSet) == PAPI_OK);
-			assert(PAPI_destroy_eventset(&eventSet) == PAPI_OK);
-#else
-			PAPI_stop(eventSet, &value);
-			papiValueTotal->get() += value;
+		// compute acceleration for this body
+		iterate(bodies, root_dsq);
 
-			PAPI_cleanup_eventset(eventSet);
-			PAPI_destroy_eventset(&eventSet);
-#endif
+		// compute new velocity
+		for(uint j = 0; j < bsize; ++j) {
+			Body& body = *bodies[j];
+			for(int i = 0; i < 3; ++i)
+				body.vel[i] += (body.acc[i] - acc[j][i]) * dthf;
 		}
 
-		tTraversal.stop();
-		tTraversalTotal->get() += tTraversal.get_usec();
-
-		delete[] acc;
+		*tTraversalTotal += Galois::readTSC() - tTraversal;
 
-		comp->lock.lock();
-		std::cerr << "\rfinished " << comp->val++ << " / " << comp->total;
-		comp->lock.unlock();
+		comp->tick();
 	}
 
 	
 
 	void iterate(BodiesPtr& bodies, double root_dsq) {
-		// init work stack with top body
-		std::stack<Frame> frame_stack;
-		frame_stack.push(Frame(bodies, top, root_dsq));
+		Scratch& scratch = scratches->get();
+		BodiesPtr& buffer = scratch.buffer;
+		std::vector<Frame>& frames = scratch.frames;
+
+		// init work stack with top body, over the whole block
+		buffer.assign(bodies.begin(), bodies.end());
+		frames.clear();
+		frames.push_back(Frame(top, root_dsq, 0, buffer.size()));
 
 		Point pos_diff;
 
-		while(!frame_stack.empty()) {
-			// BodiesPtr* new_block = new BodiesPtr();
-			BodiesPtr new_block;
-			Frame f = frame_stack.top();
-			frame_stack.pop();
+		while(!frames.empty()) {
+			Frame f = frames.back();
+			frames.pop_back();
 
-			for(uint i = 0; i < f.bodies.size(); ++i) {
-				Body& body = *(f.bodies[i]);
+			// bodies that must open the node are moved to the front of the range
+			unsigned open = f.begin;
+			for(unsigned i = f.begin; i < f.end; ++i) {
+				Body& body = *buffer[i];
 
 				computePosDiff(body, f.node, pos_diff);
 				double dist_sq = pos_diff.dist_sq();
@@ -179,11 +126,11 @@ struct BlockedComputeForces {
 					if (&body != f.node)
 						handleInteraction(body, f.node, dist_sq, pos_diff);
 				} else {
-					new_block.push_back(&body);
+					std::swap(buffer[open++], buffer[i]);
 				}
 			}
 
-			if (new_block.size() > 0) {
+			if (open > f.begin) {
 				double dist_sq = f.dist_sq * 0.25;
 
 				for(int i = 0; i < 8; ++i) {
@@ -192,11 +139,9 @@ struct BlockedComputeForces {
 					if (node == NULL)
 						break;
 
-					frame_stack.push(Frame(new_block, node, dist_sq));
+					frames.push_back(Frame(node, dist_sq, f.begin, open));
 				}
 			}
-
-			//delete &(f.bodies);
 		}
 	}
 
@@ -207,13 +152,21 @@ struct BlockedComputeForces {
 			double nphi = node->mass * idr;
 			double scale = nphi * idr * idr;
 
-			for(int i = 0; i < 3; ++i)
-				body.acc[i] += pos_diff[i] * scale;
+			body.acc.x += pos_diff.x * scale;
+			body.acc.y += pos_diff.y * scale;
+			body.acc.z += pos_diff.z * scale;
+
+			if (!node->isLeaf()) {
+				const Quadrupole* quad = static_cast<OctreeInternal*>(node)->quad;
+				if (quad)
+					quad->accelerate(pos_diff, idr, body.acc);
+			}
 		}
 
 		void computePosDiff(Body& body, Octree* node, Point& result) {
-			for(int i = 0; i < 3; ++i)
-				result[i] = node->pos[i] - body.pos[i];
+			result.x = node->pos.x - body.pos.x;
+			result.y = node->pos.y - body.pos.y;
+			result.z = node->pos.z - body.pos.z;
 		}
 };
 
@@ -4,36 +4,39 @@
 namespace Barneshut {
 
 /**
- * Computes the position of a body after a time step.
+ * Splits the bodies into contiguous blocks of at most bsize bodies.
  *
- * TODO: optimize this to reutilize memory
+ * The blocks are sized up front (reusing the ones from the previous step), so
+ * each body is written to a slot of its own and the loop can run in parallel.
  */
 struct BodyBlocksBuild {
   // Optimize runtime for no conflict case
   typedef int tt_does_not_need_aborts;
+  typedef int tt_does_not_need_stats;
 
   BodyBlocks* blocks;
+  Body* base;
   uint bsize;
 
-  BodyBlocksBuild(BodyBlocks* _blocks, int _bsize) :
+  BodyBlocksBuild(BodyBlocks* _blocks, Bodies& bodies, int _bsize) :
     blocks(_blocks),
+    base(&bodies[0]),
     bsize(_bsize) {
-    blocks->clear();
-    blocks->push_back(new BodiesPtr());
+    uint nblocks = (bodies.size() + bsize - 1) / bsize;
+    for (uint i = nblocks; i < blocks->size(); ++i)
+      delete (*blocks)[i];
+    uint old = blocks->size();
+    blocks->resize(nblocks);
+    for (uint i = old; i < nblocks; ++i)
+      (*blocks)[i] = new BodiesPtr();
+    for (uint i = 0; i < nblocks; ++i)
+      (*blocks)[i]->resize(std::min<size_t>(bsize, bodies.size() - i * bsize));
   }
 
   template<typename Context>
   void operator()(Body* bb, Context&) {
-    BodiesPtr* currentBlock = blocks->back();
-
-    // if block size is maxed out, create 
-    if (currentBlock->size() == bsize) {
-      currentBlock = new BodiesPtr();
-      blocks->push_back(currentBlock);
-    }
-
-    // add current body to current block
-    currentBlock->push_back(bb);
+    uint i = bb - base;
+    (*(*blocks)[i / bsize])[i % bsize] = bb;
   }
 };
 
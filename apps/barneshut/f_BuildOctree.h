@@ -2,23 +2,41 @@
 #define ___F_BUILD_OCTREE_H___
 
 #include "Octree.h"
+#include "NodeArena.h"
 #include "utilities.h"
 
 namespace Barneshut {
 
-/** Builds the Octree using recursive calls.
- * When it finds a leaf, it is replaced by an internal, and both the leaf and the new body are recursively inserted in the new internal.
+/** Builds the Octree by inserting bodies concurrently.
+ * Each child slot only ever goes from NULL to a leaf, and from a leaf to an
+ * internal node, so both transitions are published with a CAS on the slot.
+ * When a leaf is found, a new internal node holding that leaf is built
+ * privately and swapped in; the body insertion then continues below it.
+ * The resulting tree only depends on the set of bodies, not on the order in
+ * which they were inserted. New nodes come from the per thread arena, so a
+ * node that lost the race is simply abandoned until the arena is reset.
+ *
+ * With a bucket size B > 1, a second body in an octant starts a bucket
+ * instead, filled slot by slot with the same CAS. A full bucket can no
+ * longer change, so it is split by building a cell from its bodies
+ * privately and swapping it in for the bucket. Cells then hold more than B
+ * bodies, and buckets at most B, still whatever the insertion order.
  */
 struct BuildOctree {
-  // NB: only correct when run sequentially
+  // Optimize runtime for no conflict case
+  typedef int tt_does_not_need_aborts;
   typedef int tt_does_not_need_stats;
 
   OctreeInternal* root;
   double root_radius;
+  NodeArena* arena;
+  unsigned bucket_size;
 
-  BuildOctree(OctreeInternal* _root, double radius) :
+  BuildOctree(OctreeInternal* _root, double radius, NodeArena* _arena, unsigned _bucket_size = 1) :
     root(_root),
-    root_radius(radius) { }
+    root_radius(radius),
+    arena(_arena),
+    bucket_size(_bucket_size) { }
 
   template<typename Context>
   void operator()(Body* b, Context&) {
@@ -26,37 +44,72 @@ struct BuildOctree {
   }
 
   void insert(Body* b, OctreeInternal* node, double radius) {
-    // calc the child node where this body should belong to
-    int index = getIndex(node->pos, b->pos);
+    while (true) {
+      assert(!node->isLeaf());
 
-    assert(!node->isLeaf());
+      // calc the child node where this body should belong to
+      int index = getIndex(node->pos, b->pos);
+      Octree* child = node->child[index];
 
-    Octree *child = node->child[index];
-    
-    // if there is no child, make it a leaf node
-    if (child == NULL) {
-      node->child[index] = b;
-      return;
-    }
-    
-    // if child is a leaf, expand it into an OctreeInternal
-    radius *= 0.5;
-    if (child->isLeaf()) {
-      // Expand leaf
-      Body* n = static_cast<Body*>(child);
-      Point new_pos(node->pos);
-      updateCenter(new_pos, index, radius);
-      OctreeInternal* new_node = new OctreeInternal(new_pos);
-
-      assert(n->pos != b->pos);
-      
-      // insert both the old leaf and the new body into the new node
-      insert(b, new_node, radius);
-      insert(n, new_node, radius);
-      node->child[index] = new_node;
-    } else { // else just recursively insert the body into the child node
-      OctreeInternal* n = static_cast<OctreeInternal*>(child);
-      insert(b, n, radius);
+      // if there is no child, make it a leaf node
+      if (child == NULL) {
+        if (__sync_bool_compare_and_swap(&node->child[index], child, b))
+          return;
+        // somebody else took the slot, look at it again
+        continue;
+      }
+
+      // a second body starts a bucket, built privately like the cells below
+      if (child->isLeaf() && bucket_size > 1) {
+        Point new_pos(node->pos);
+        updateCenter(new_pos, index, radius * 0.5);
+        OctreeInternal* new_node = arena->create<OctreeInternal>(new_pos);
+        new_node->octant = index;
+        new_node->bucket = true;
+        new_node->child[0] = child;
+        new_node->child[1] = b;
+        if (__sync_bool_compare_and_swap(&node->child[index], child, new_node))
+          return;
+        continue;
+      }
+
+      if (!child->isLeaf() && static_cast<OctreeInternal*>(child)->bucket) {
+        OctreeInternal* n = static_cast<OctreeInternal*>(child);
+        for (unsigned i = 0; i < bucket_size; ++i) {
+          if (n->child[i] == NULL && __sync_bool_compare_and_swap(&n->child[i], static_cast<Octree*>(NULL), b))
+            return;
+        }
+
+        // full, split it into a cell
+        OctreeInternal* new_node = arena->create<OctreeInternal>(n->pos);
+        new_node->octant = index;
+        for (unsigned i = 0; i < bucket_size; ++i)
+          insert(static_cast<Body*>(n->child[i]), new_node, radius * 0.5);
+        if (!__sync_bool_compare_and_swap(&node->child[index], child, new_node))
+          continue;
+        child = new_node;
+      }
+
+      // if child is a leaf, expand it into an OctreeInternal
+      if (child->isLeaf()) {
+        Body* n = static_cast<Body*>(child);
+        Point new_pos(node->pos);
+        updateCenter(new_pos, index, radius * 0.5);
+        OctreeInternal* new_node = arena->create<OctreeInternal>(new_pos);
+        new_node->octant = index;
+
+        assert(n->pos != b->pos);
+
+        // the new node is still private, so the old leaf goes straight in
+        new_node->child[getIndex(new_pos, n->pos)] = n;
+        if (!__sync_bool_compare_and_swap(&node->child[index], child, new_node))
+          continue;
+        child = new_node;
+      }
+
+      // descend into the child node
+      node = static_cast<OctreeInternal*>(child);
+      radius *= 0.5;
     }
   }
 };
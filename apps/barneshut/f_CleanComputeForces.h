@@ -2,11 +2,14 @@
 #define ___F_CLEAN_COMPUTE_FORCES___
 
 //	Libraries includes
-#include <Galois/Accumulator.h>
+#include <Galois/Statistic.h>
+#include <Galois/Runtime/Progress.h>
 
 //	local includes
 #include "config.h"
 #include "Octree.h"
+#include "BodyStore.h"
+#include "ReplicatedTop.h"
 
 namespace Barneshut {
 
@@ -28,122 +31,86 @@ struct CleanComputeForces {
 	double dthf;
 	double epssq;
 
-	Galois::GAccumulator<unsigned> * const tTraversalTotal;
-	Completeness* comp;
+	Galois::CycleStatistic * const tTraversalTotal;
+	GaloisRuntime::Progress* comp;
 
-	std::string papiEventName;
-	Galois::GAccumulator<long long int> * const papiValueTotal;
+	// bodies to walk by index, see operator()(uint32_t)
+	BodyStore* store;
 
-	CleanComputeForces(OctreeInternal* _top, double _diameter, double itolsq, double _dthf, double _epssq, Galois::GAccumulator<unsigned> * const _tTraversalTotal = NULL, const std::string& _papiEventName = "", Galois::GAccumulator<long long int> * const _papiValueTotal = NULL, Completeness* _comp = NULL)
+	// when given, walks start from the copy of the thread's package
+	ReplicatedTop* tops;
+
+	CleanComputeForces(OctreeInternal* _top, double _diameter, double itolsq, double _dthf, double _epssq, Galois::CycleStatistic * const _tTraversalTotal = NULL, GaloisRuntime::Progress* _comp = NULL, BodyStore* _store = NULL, ReplicatedTop* _tops = NULL)
 	: top(_top)
 	, diameter(_diameter)
 	, dthf(_dthf)
 	, epssq(_epssq)
 	, tTraversalTotal(_tTraversalTotal)
-	, papiEventName(_papiEventName)
-	, papiValueTotal(_papiValueTotal)
 	, comp(_comp)
+	, store(_store)
+	, tops(_tops)
 	{
 		root_dsq = diameter * diameter * itolsq;
 	}
 
+	/**
+	 * Operator over the body store: same walk, reading and updating body
+	 * index of the store instead of the Body objects
+	 */
+	template<typename Context>
+	void operator()(uint32_t index, Context&) {
+		unsigned long long tTraversal = Galois::readTSC();
+
+		// compute acceleration for this body
+		Point acc;
+		iterate(index, root_dsq, acc);
+
+		// compute new velocity
+		store->vx[index] += (acc.x - store->ax[index]) * dthf;
+		store->vy[index] += (acc.y - store->ay[index]) * dthf;
+		store->vz[index] += (acc.z - store->az[index]) * dthf;
+		store->ax[index] = acc.x;
+		store->ay[index] = acc.y;
+		store->az[index] = acc.z;
+
+		*tTraversalTotal += Galois::readTSC() - tTraversal;
+
+		comp->tick();
+	}
+
 	/**
 	 * Operator
 	 */
 	template<typename Context>
 	void operator()(Body* bb, Context&) {
 		Body& body = *bb;
-		Galois::StatTimer tTraversal;
-		tTraversal.start();
-
-		if (papiEventName.empty()) {
-			// backup previous acceleration and initialize new accel to 0
-			Point acc = body.acc;
-			for(int i = 0; i < 3; ++i)
-				body.acc[i] = 0;
-
-			// compute acceleration for this body
-			iterate(body, root_dsq);
-
-			// compute new velocity
-			for(int i = 0; i < 3; ++i)
-				body.vel[i] += (body.acc[i] - acc[i]) * dthf;
-		} else {
-#ifndef NDEBUG
-			int event;
-			char * name = strdup(papiEventName.c_str());
-			assert(PAPI_event_name_to_code(name, &event) == PAPI_OK);
-			free(name);
-
-			int eventSet = PAPI_NULL;
-			assert(PAPI_create_eventset(&eventSet) == PAPI_OK);
-			assert(PAPI_add_event(eventSet, event) == PAPI_OK);
-
-			long long int value;
-			assert(PAPI_start(eventSet) == PAPI_OK);
-#else
-			int event;
-			char * name = strdup(papiEventName.c_str());
-			int result = PAPI_event_name_to_code(name, &event);
-			// if (result != PAPI_OK)
-			// 	std::cerr << "PAPI_event_name_to_code: " << PAPI_strerror(result) << std::endl;
-			free(name);
-
-			int eventSet = PAPI_NULL;
-			result = PAPI_create_eventset(&eventSet);
-			// if (result != PAPI_OK)
-			// 	std::cerr << "PAPI_create_eventset: " << PAPI_strerror(result) << std::endl;
-			result = PAPI_add_event(eventSet, event);
-			// if (result != PAPI_OK)
-			// 	std::cerr << "PAPI_add_event: " << PAPI_strerror(result) << std::endl;
-
-
-			long long int value;
-			result = PAPI_start(eventSet);
-			// if (result != PAPI_OK)
-			// 	std::cerr << "PAPI_start: " << PAPI_strerror(result) << std::endl;
-#endif
-
-			// backup previous acceleration and initialize new accel to 0
-			Point acc = body.acc;
-			for(int i = 0; i < 3; ++i)
-				body.acc[i] = 0;
-
-			// compute acceleration for this body
-			iterate(body, root_dsq);
-
-			// compute new velocity
-			for(int i = 0; i < 3; ++i)
-				body.vel[i] += (body.acc[i] - acc[i]) * dthf;
-
-#ifndef NDEBUG
-			assert(PAPI_stop(eventSet, &value) == PAPI_OK);
-			papiValueTotal->get() += value;
-			assert(PAPI_cleanup_eventset(eventSet) == PAPI_OK);
-			assert(PAPI_destroy_eventset(&eventSet) == PAPI_OK);
-#else
-			PAPI_stop(eventSet, &value);
-			papiValueTotal->get() += value;
-			PAPI_cleanup_eventset(eventSet);
-			PAPI_destroy_eventset(&eventSet);
-#endif
-		}
+		unsigned long long tTraversal = Galois::readTSC();
+
+		// backup previous acceleration and initialize new accel to 0
+		Point acc = body.acc;
+		for(int i = 0; i < 3; ++i)
+			body.acc[i] = 0;
+
+		// compute acceleration for this body
+		iterate(body, root_dsq);
 
-		tTraversal.stop();
-		tTraversalTotal->get() += tTraversal.get_usec();
+		// compute new velocity
+		for(int i = 0; i < 3; ++i)
+			body.vel[i] += (body.acc[i] - acc[i]) * dthf;
 
-		comp->lock.lock();
-		std::cerr << "\rfinished " << comp->val++ << " / " << comp->total;
-		comp->lock.unlock();
+		*tTraversalTotal += Galois::readTSC() - tTraversal;
+
+		comp->tick();
 	}
 
 
 	void iterate(Body& body, double root_dsq) {
 		// init work stack with top body
 		std::stack<Frame> frame_stack;
-		frame_stack.push(Frame(top, root_dsq));
+		frame_stack.push(Frame(tops ? tops->local() : top, root_dsq));
 
 		Point pos_diff;
+		unsigned cost = 0;
 
 		while(!frame_stack.empty()) {
 			Frame f = frame_stack.top();
@@ -154,6 +121,7 @@ struct CleanComputeForces {
 
 			if (dist_sq >= f.dist_sq) {
 				handleInteraction(body, f.node, dist_sq, pos_diff);
+				++cost;
 				continue;
 			}
 
@@ -170,7 +138,82 @@ struct CleanComputeForces {
 						computePosDiff(body, next, pos_diff);
 						double new_dist_sq = pos_diff.dist_sq();
 						handleInteraction(body, next, new_dist_sq, pos_diff);
+						++cost;
+					}
+				} else if (static_cast<OctreeInternal*>(next)->bucket) {
+					cost += bucket(body, static_cast<OctreeInternal*>(next), dist_sq);
+				} else {
+					frame_stack.push(Frame(static_cast<OctreeInternal*>(next), dist_sq));
+				}
+			}
+		}
+		body.cost = cost;
+	}
+
+	/**
+	 * A bucket is opened in place instead of being stacked: its bodies are
+	 * packed from child[0], so a close one is a direct sum over them.
+	 * Returns the interactions
+	 */
+	unsigned bucket(Body& body, OctreeInternal* cell, double open_dsq) {
+		Point pos_diff;
+		computePosDiff(body, cell, pos_diff);
+		double dist_sq = pos_diff.dist_sq();
+		if (dist_sq >= open_dsq) {
+			handleInteraction(body, cell, dist_sq, pos_diff);
+			return 1;
+		}
+
+		unsigned cost = 0;
+		for (int i = 0; i < 8 && cell->child[i] != NULL; ++i) {
+			Octree* b = cell->child[i];
+			if (b == &body)
+				continue;
+			computePosDiff(body, b, pos_diff);
+			accelerate(b->mass, NULL, pos_diff.dist_sq(), pos_diff, body.acc);
+			++cost;
+		}
+		return cost;
+	}
+
+	/**
+	 * The walk above for body index of the store. Leaves are told apart by
+	 * their address, so the Body objects are never read
+	 */
+	void iterate(uint32_t index, double root_dsq, Point& acc) {
+		std::stack<Frame> frame_stack;
+		frame_stack.push(Frame(tops ? tops->local() : top, root_dsq));
+
+		const Point pos = store->pos(index);
+		Point pos_diff;
+
+		while(!frame_stack.empty()) {
+			Frame f = frame_stack.top();
+			frame_stack.pop();
+
+			computePosDiff(pos, f.node->pos, pos_diff);
+			double dist_sq = pos_diff.dist_sq();
+
+			if (dist_sq >= f.dist_sq) {
+				accelerate(f.node->mass, f.node->quad, dist_sq, pos_diff, acc);
+				continue;
+			}
+
+			dist_sq = f.dist_sq * 0.25;
+
+			for(int i = 0; i < 8; ++i) {
+				Octree* next = f.node->child[i];
+				if (next == NULL)
+					break;
+
+				if (store->contains(next)) {
+					uint32_t j = store->index(next);
+					if (j != index) {
+						computePosDiff(pos, store->pos(j), pos_diff);
+						accelerate(store->mass[j], NULL, pos_diff.dist_sq(), pos_diff, acc);
 					}
+				} else if (static_cast<OctreeInternal*>(next)->bucket) {
+					bucket(index, pos, static_cast<OctreeInternal*>(next), dist_sq, acc);
 				} else {
 					frame_stack.push(Frame(static_cast<OctreeInternal*>(next), dist_sq));
 				}
@@ -178,20 +221,53 @@ struct CleanComputeForces {
 		}
 	}
 
+	//! bucket() above for body index of the store
+	void bucket(uint32_t index, const Point& pos, OctreeInternal* cell, double open_dsq, Point& acc) {
+		Point pos_diff;
+		computePosDiff(pos, cell->pos, pos_diff);
+		double dist_sq = pos_diff.dist_sq();
+		if (dist_sq >= open_dsq) {
+			accelerate(cell->mass, cell->quad, dist_sq, pos_diff, acc);
+			return;
+		}
+
+		for (int i = 0; i < 8 && cell->child[i] != NULL; ++i) {
+			uint32_t j = store->index(cell->child[i]);
+			if (j == index)
+				continue;
+			computePosDiff(pos, store->pos(j), pos_diff);
+			accelerate(store->mass[j], NULL, pos_diff.dist_sq(), pos_diff, acc);
+		}
+	}
+
 	private:
 		void handleInteraction(Body& body, Octree* node, double dist_sq, Point& pos_diff) {
+			const Quadrupole* quad = node->isLeaf() ? NULL : static_cast<OctreeInternal*>(node)->quad;
+			accelerate(node->mass, quad, dist_sq, pos_diff, body.acc);
+		}
+
+		void accelerate(double mass, const Quadrupole* quad, double dist_sq, const Point& pos_diff, Point& acc) {
 			dist_sq += epssq;
 			double idr = 1 / sqrt(dist_sq);
-			double nphi = node->mass * idr;
+			double nphi = mass * idr;
 			double scale = nphi * idr * idr;
 
-			for(int i = 0; i < 3; ++i)
-				body.acc[i] += pos_diff[i] * scale;
+			acc.x += pos_diff.x * scale;
+			acc.y += pos_diff.y * scale;
+			acc.z += pos_diff.z * scale;
+
+			if (quad)
+				quad->accelerate(pos_diff, idr, acc);
 		}
 
 		void computePosDiff(Body& body, Octree* node, Point& result) {
-			for(int i = 0; i < 3; ++i)
-				result[i] = node->pos[i] - body.pos[i];
+			computePosDiff(body.pos, node->pos, result);
+		}
+
+		void computePosDiff(const Point& from, const Point& to, Point& result) {
+			result.x = to.x - from.x;
+			result.y = to.y - from.y;
+			result.z = to.z - from.z;
 		}
 };
 
@@ -1,49 +1,96 @@
 #ifndef ___F_COMPUTE_CENTER_OF_MASS_H___
 #define ___F_COMPUTE_CENTER_OF_MASS_H___
 
+#include <vector>
+
+#include <Galois/Galois.h>
+
 #include "Octree.h"
+#include "NodeArena.h"
+#include "utilities.h"
 
 namespace Barneshut {
 
 /**
  * Functor
  *
- * Computes the center of mass for each node of the Octree
+ * Computes the center of mass for each node of the Octree, along with the
+ * number of nodes and of bodies in each subtree. When given an arena, it also
+ * allocates and computes the quadrupole moment of every internal node.
+ *
+ * The subtrees rooted at depth `cutoff` are independent, so they are
+ * summarized in parallel first. The few levels above them are then finished
+ * sequentially, reusing the masses already computed below the cut.
  */
 
 struct ComputeCenterOfMass {
-  // NB: only correct when run sequentially or tree-like reduction
+  // Optimize runtime for no conflict case
+  typedef int tt_does_not_need_aborts;
   typedef int tt_does_not_need_stats;
   OctreeInternal* root;
+  NodeArena* quads;
+  unsigned cutoff;
 
-  ComputeCenterOfMass(OctreeInternal* _root) : root(_root) { }
+  ComputeCenterOfMass(OctreeInternal* _root, NodeArena* _quads = NULL) :
+    root(_root),
+    quads(_quads),
+    cutoff(parallelCutoff(Galois::getActiveThreads())) { }
 
   /**
    * Center of mass for top of the tree is given after recursing the entire tree, computing each node's center of mass
    */
   void operator()() {
-    root->mass = recurse(root);
+    typedef GaloisRuntime::WorkList::dChunkedLIFO<1> WL;
+    std::vector<OctreeInternal*> subtrees;
+    collect(root, 0, subtrees);
+    Galois::for_each<WL>(subtrees.begin(), subtrees.end(), *this);
+
+    root->mass = recurse(root, cutoff);
+  }
+
+  /**
+   * Summarizes a whole subtree below the cut
+   */
+  template<typename Context>
+  void operator()(OctreeInternal* node, Context&) {
+    recurse(node, ~0u);
   }
 
 private:
-  double recurse(OctreeInternal* node) {
+  // gathers the internal nodes found at the cutoff depth
+  void collect(OctreeInternal* node, unsigned depth, std::vector<OctreeInternal*>& subtrees) {
+    if (depth == cutoff) {
+      subtrees.push_back(node);
+      return;
+    }
+    for (int i = 0; i < 8; i++) {
+      Octree* child = node->child[i];
+      if (child != NULL && !child->isLeaf())
+        collect(static_cast<OctreeInternal*>(child), depth + 1, subtrees);
+    }
+  }
+
+  // levels is how deep to go before relying on the already computed masses
+  double recurse(OctreeInternal* node, unsigned levels) {
     double mass = 0.0;
+    unsigned size = 1;
+    unsigned nbodies = 0;
     int index = 0;
     Point accum;
-    
+
     // iterate all existing childs of current node
     for (int i = 0; i < 8; i++) {
       Octree* child = node->child[i];
       if (child == NULL)
         continue;
 
-      // Reorganize leaves to be denser up front 
+      // Reorganize leaves to be denser up front
       if (index != i) {
         node->child[index] = child;
         node->child[i] = NULL;
       }
       index++;
-      
+
       // for the leaves, center of mass is direct
       // for inner nodes, it is recursively given
       double m;
@@ -52,29 +99,55 @@ private:
         Body* n = static_cast<Body*>(child);
         m = n->mass;
         p = &n->pos;
+        size += 1;
+        nbodies += 1;
       } else {
         OctreeInternal* n = static_cast<OctreeInternal*>(child);
-        m = recurse(n);
+        m = levels > 1 ? recurse(n, levels - 1) : n->mass;
         p = &n->pos;
+        size += n->size;
+        nbodies += n->nbodies;
       }
 
       mass += m;
-      for (int j = 0; j < 3; j++) 
+      for (int j = 0; j < 3; j++)
         accum[j] += (*p)[j] * m;
     }
 
     node->mass = mass;
-    
+    node->size = size;
+    node->nbodies = nbodies;
+
     if (mass > 0.0) {
       double inv_mass = 1.0 / mass;
       for (int j = 0; j < 3; j++)
         node->pos[j] = accum[j] * inv_mass;
     }
 
+    if (quads)
+      computeQuadrupole(node);
+
     return mass;
   }
+
+  // children are compacted and summarized, and node->pos is final
+  void computeQuadrupole(OctreeInternal* node) {
+    Quadrupole* q = quads->create<Quadrupole>();
+    for (int i = 0; i < 8; i++) {
+      Octree* child = node->child[i];
+      if (child == NULL)
+        break;
+
+      // parallel axis theorem: the child's moment shifted to this center
+      Point d(child->pos.x - node->pos.x, child->pos.y - node->pos.y, child->pos.z - node->pos.z);
+      q->add(child->mass, d);
+      if (!child->isLeaf())
+        q->add(*static_cast<OctreeInternal*>(child)->quad);
+    }
+    node->quad = q;
+  }
 };
 
 }
 
-#endif//___F_COMPUTE_CENTER_OF_MASS_H___
\ No newline at end of file
+#endif//___F_COMPUTE_CENTER_OF_MASS_H___
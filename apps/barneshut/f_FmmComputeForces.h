@@ -0,0 +1,253 @@
+#ifndef ___F_FMM_COMPUTE_FORCES_H___
+#define ___F_FMM_COMPUTE_FORCES_H___
+
+#include <vector>
+#include <algorithm>
+
+//	Libraries includes
+#include <Galois/Galois.h>
+#include <Galois/Statistic.h>
+#include <Galois/Runtime/PerCPU.h>
+#include <Galois/Runtime/Progress.h>
+
+//	local includes
+#include "config.h"
+#include "Octree.h"
+#include "NodeArena.h"
+
+namespace Barneshut {
+
+/**
+ * First order local expansion of the far field around a cell's center of
+ * mass: the acceleration there and its gradient, the (symmetric) tidal tensor.
+ */
+struct LocalExpansion {
+	Point acc;
+	double xx, xy, xz, yy, yz, zz;
+	LocalExpansion() : xx(0.0), xy(0.0), xz(0.0), yy(0.0), yz(0.0), zz(0.0) { }
+
+	// the far field at offset d from the center
+	Point at(const Point& d) const {
+		return Point(
+			acc.x + xx * d.x + xy * d.y + xz * d.z,
+			acc.y + xy * d.x + yy * d.y + yz * d.z,
+			acc.z + xz * d.x + yz * d.y + zz * d.z);
+	}
+
+	// the same expansion, moved to offset d from the center
+	LocalExpansion shifted(const Point& d) const {
+		LocalExpansion l(*this);
+		l.acc = at(d);
+		return l;
+	}
+};
+
+/**
+ * Dual tree walk (fast multipole method) over the same octree.
+ *
+ * Each task is a target cell along with the source nodes that were still too
+ * close to its parent. Sources far enough from the whole cell are translated
+ * into the cell's local expansion (M2L); bigger sources are opened in place;
+ * the rest are handed down to the children, which inherit the expansion
+ * shifted to their own center (L2L). Bodies take the expansion at their
+ * position (L2P) and finish their remaining sources as a Barnes-Hut walk.
+ *
+ * The opening test compares the sum of both cell sizes with the distance of
+ * their centers of mass, using the same tolerance as the per body walks.
+ * Cell moments come from ComputeCenterOfMass and must include quadrupoles.
+ */
+struct FmmComputeForces {
+	// Optimize runtime for no conflict case
+	typedef int tt_does_not_need_aborts;
+
+	// node along with the side of its cell, 0 for bodies
+	struct Source {
+		Octree* node;
+		double size;
+		Source(Octree* _node, double _size) : node(_node), size(_size) { }
+	};
+
+	struct Task {
+		OctreeInternal* cell;
+		double size;
+		const Source* sources;
+		unsigned nsources;
+		LocalExpansion local;
+		Task(OctreeInternal* _cell, double _size, const Source* _sources, unsigned _nsources, const LocalExpansion& _local)
+		: cell(_cell), size(_size), sources(_sources), nsources(_nsources), local(_local) { }
+	};
+
+	// per thread working memory, kept across tasks and timesteps
+	struct Scratch {
+		std::vector<Source> stack;
+		std::vector<Source> near;
+	};
+	typedef GaloisRuntime::PerCPU<Scratch> Scratches;
+
+	NodeArena* arena;
+	Scratches* scratches;
+
+	double itolsq;
+	double dthf;
+	double epssq;
+
+	Galois::CycleStatistic * const tTraversalTotal;
+	GaloisRuntime::Progress* comp;
+
+	FmmComputeForces(NodeArena* _arena, Scratches* _scratches, double _itolsq, double _dthf, double _epssq, Galois::CycleStatistic * const _tTraversalTotal = NULL, GaloisRuntime::Progress* _comp = NULL)
+	: arena(_arena)
+	, scratches(_scratches)
+	, itolsq(_itolsq)
+	, dthf(_dthf)
+	, epssq(_epssq)
+	, tTraversalTotal(_tTraversalTotal)
+	, comp(_comp)
+	{ }
+
+	/**
+	 * Runs the whole walk from top, whose cell has side size
+	 */
+	void operator()(OctreeInternal* top, double size) {
+		typedef GaloisRuntime::WorkList::dChunkedLIFO<16> WL;
+		Source* root = static_cast<Source*>(arena->allocate(sizeof(Source)));
+		*root = Source(top, size);
+		Task task(top, size, root, 1, LocalExpansion());
+		Galois::for_each<WL>(&task, &task + 1, *this);
+	}
+
+	/**
+	 * Operator
+	 */
+	template<typename Context>
+	void operator()(const Task& t, Context& ctx) {
+		unsigned long long tTraversal = Galois::readTSC();
+		Scratch& scratch = scratches->get();
+		std::vector<Source>& stack = scratch.stack;
+		std::vector<Source>& near = scratch.near;
+		OctreeInternal* cell = t.cell;
+		LocalExpansion local = t.local;
+
+		stack.assign(t.sources, t.sources + t.nsources);
+		near.clear();
+		while (!stack.empty()) {
+			Source src = stack.back();
+			stack.pop_back();
+
+			Point pos_diff = diff(src.node->pos, cell->pos);
+			double dist_sq = pos_diff.dist_sq();
+			double reach = t.size + src.size;
+
+			if (dist_sq >= reach * reach * itolsq)
+				translate(src.node, pos_diff, dist_sq, local);
+			else if (!src.node->isLeaf() && src.size > t.size)
+				open(src, stack);
+			else
+				near.push_back(src);
+		}
+
+		// the children share one copy of what is left
+		Source* passed = NULL;
+		if (!near.empty()) {
+			passed = static_cast<Source*>(arena->allocate(sizeof(Source) * near.size()));
+			std::copy(near.begin(), near.end(), passed);
+		}
+
+		for (int i = 0; i < 8; ++i) {
+			Octree* child = cell->child[i];
+			if (child == NULL)
+				break;
+
+			Point offset = diff(child->pos, cell->pos);
+			if (child->isLeaf())
+				evaluate(*static_cast<Body*>(child), local.at(offset), passed, near.size(), stack);
+			else
+				ctx.push(Task(static_cast<OctreeInternal*>(child), t.size * 0.5, passed, near.size(), local.shifted(offset)));
+		}
+
+		*tTraversalTotal += Galois::readTSC() - tTraversal;
+
+		comp->tick();
+	}
+
+private:
+	static Point diff(const Point& a, const Point& b) {
+		return Point(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	static void open(const Source& src, std::vector<Source>& stack) {
+		OctreeInternal* node = static_cast<OctreeInternal*>(src.node);
+		for (int i = 0; i < 8; ++i) {
+			Octree* child = node->child[i];
+			if (child == NULL)
+				break;
+			stack.push_back(Source(child, child->isLeaf() ? 0.0 : src.size * 0.5));
+		}
+	}
+
+	/**
+	 * Field of body at the end of the walk: far from the expansion, near from
+	 * the sources its cell could not translate
+	 */
+	void evaluate(Body& body, const Point& far, const Source* sources, unsigned nsources, std::vector<Source>& stack) {
+		// backup previous acceleration and start from the far field
+		Point acc = body.acc;
+		body.acc = far;
+
+		stack.assign(sources, sources + nsources);
+		while (!stack.empty()) {
+			Source src = stack.back();
+			stack.pop_back();
+			if (src.node == &body)
+				continue;
+
+			Point pos_diff = diff(src.node->pos, body.pos);
+			double dist_sq = pos_diff.dist_sq();
+			if (src.node->isLeaf() || dist_sq >= src.size * src.size * itolsq)
+				interact(src.node, pos_diff, dist_sq, body.acc);
+			else
+				open(src, stack);
+		}
+
+		// compute new velocity
+		body.vel.x += (body.acc.x - acc.x) * dthf;
+		body.vel.y += (body.acc.y - acc.y) * dthf;
+		body.vel.z += (body.acc.z - acc.z) * dthf;
+	}
+
+	// acceleration by node at offset pos_diff, with its quadrupole if any
+	void interact(Octree* node, const Point& pos_diff, double dist_sq, Point& acc) {
+		dist_sq += epssq;
+		double idr = 1 / sqrt(dist_sq);
+		double scale = node->mass * idr * idr * idr;
+		acc.x += pos_diff.x * scale;
+		acc.y += pos_diff.y * scale;
+		acc.z += pos_diff.z * scale;
+
+		if (!node->isLeaf()) {
+			const Quadrupole* quad = static_cast<OctreeInternal*>(node)->quad;
+			if (quad)
+				quad->accelerate(pos_diff, idr, acc);
+		}
+	}
+
+	// M2L: adds the field of node, at offset pos_diff, to the local expansion
+	void translate(Octree* node, const Point& pos_diff, double dist_sq, LocalExpansion& local) {
+		interact(node, pos_diff, dist_sq, local.acc);
+
+		// gradient of the monopole field, m (3 d d^T / |d|^5 - I / |d|^3)
+		const Point& d = pos_diff;
+		double idr = 1 / sqrt(dist_sq + epssq);
+		double idr3 = node->mass * idr * idr * idr;
+		double idr5 = 3 * idr3 * idr * idr;
+		local.xx += idr5 * d.x * d.x - idr3;
+		local.xy += idr5 * d.x * d.y;
+		local.xz += idr5 * d.x * d.z;
+		local.yy += idr5 * d.y * d.y - idr3;
+		local.yz += idr5 * d.y * d.z;
+		local.zz += idr5 * d.z * d.z - idr3;
+	}
+};
+
+}//	namespace Barneshut
+
+#endif//___F_FMM_COMPUTE_FORCES_H___
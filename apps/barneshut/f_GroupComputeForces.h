@@ -0,0 +1,197 @@
+#ifndef ___F_GROUP_COMPUTE_FORCES_H___
+#define ___F_GROUP_COMPUTE_FORCES_H___
+
+#include <vector>
+#include <algorithm>
+
+//	Libraries includes
+#include <Galois/Statistic.h>
+#include <Galois/Runtime/Progress.h>
+
+//	local includes
+#include "config.h"
+#include "Octree.h"
+#include "LinearOctree.h"
+#include "InteractionList.h"
+#include "f_SimdComputeForces.h"
+
+namespace Barneshut {
+
+/**
+ * Octree cell holding at most G bodies, given by its range [begin, end) in
+ * the flattened tree. A lone body hanging off a bigger cell is a group too.
+ */
+struct BodyGroup {
+	uint32_t begin, end;
+	BodyGroup(uint32_t _begin, uint32_t _end) : begin(_begin), end(_end) { }
+};
+
+/**
+ * Finds the largest cells with at most G bodies, in the same depth-first
+ * order used by LinearOctree. Needs the subtree counts of ComputeCenterOfMass
+ */
+class GroupCollector {
+	unsigned G;
+	std::vector<BodyGroup>& groups;
+
+	void recurse(OctreeInternal* cell, uint32_t index) {
+		uint32_t c = index + 1;
+		for (int i = 0; i < 8; ++i) {
+			Octree* child = cell->child[i];
+			if (child == NULL)
+				break;
+
+			uint32_t size = 1;
+			unsigned nbodies = 1;
+			if (!child->isLeaf()) {
+				OctreeInternal* n = static_cast<OctreeInternal*>(child);
+				size = n->size;
+				nbodies = n->nbodies;
+			}
+
+			if (nbodies <= G)
+				groups.push_back(BodyGroup(c, c + size));
+			else
+				recurse(static_cast<OctreeInternal*>(child), c);
+			c += size;
+		}
+	}
+
+public:
+	GroupCollector(unsigned _G, std::vector<BodyGroup>& _groups) : G(_G), groups(_groups) { }
+
+	void operator()(OctreeInternal* top) {
+		groups.clear();
+		if (top->nbodies <= G)
+			groups.push_back(BodyGroup(0, top->size));
+		else
+			recurse(top, 0);
+	}
+};
+
+/**
+ * Group walk: the opening criterion is tested once per group, against the
+ * group's bounding box, and the resulting interaction list is shared by every
+ * body in the group. The group's own bodies end up in the list as well; their
+ * self interaction has a null offset and adds nothing.
+ *
+ * Scalar is the precision of the interactions, taken around the center of
+ * the group's box.
+ */
+template<typename Scalar>
+struct GroupComputeForcesOf {
+	// Optimize runtime for no conflict case
+	typedef int tt_does_not_need_aborts;
+
+	typedef InteractionListOf<Scalar> List;
+	typedef GaloisRuntime::PerCPU<List> Lists;
+	typedef typename ForceKernelOf<Scalar>::type Kernel;
+
+	const LinearOctree* tree;
+	Lists* lists;
+	Kernel kernel;
+
+	double dthf;
+	double epssq;
+
+	Galois::CycleStatistic * const tTraversalTotal;
+	GaloisRuntime::Progress* comp;
+
+	GroupComputeForcesOf(const LinearOctree* _tree, Lists* _lists, Kernel _kernel, double _dthf, double _epssq, Galois::CycleStatistic * const _tTraversalTotal = NULL, GaloisRuntime::Progress* _comp = NULL)
+	: tree(_tree)
+	, lists(_lists)
+	, kernel(_kernel)
+	, dthf(_dthf)
+	, epssq(_epssq)
+	, tTraversalTotal(_tTraversalTotal)
+	, comp(_comp)
+	{ }
+
+	/**
+	 * Operator
+	 */
+	template<typename Context>
+	void operator()(const BodyGroup& group, Context&) {
+		unsigned long long tTraversal = Galois::readTSC();
+
+		// bounding box of the group's bodies
+		Point lo(std::numeric_limits<double>::max());
+		Point hi(-std::numeric_limits<double>::max());
+		for (uint32_t j = group.begin; j < group.end; ++j) {
+			const LinearNode& n = (*tree)[j];
+			if (n.isCell())
+				continue;
+			lo.x = std::min(lo.x, n.pos.x);
+			lo.y = std::min(lo.y, n.pos.y);
+			lo.z = std::min(lo.z, n.pos.z);
+			hi.x = std::max(hi.x, n.pos.x);
+			hi.y = std::max(hi.y, n.pos.y);
+			hi.z = std::max(hi.z, n.pos.z);
+		}
+
+		// the list is taken around the center of the box
+		List& list = lists->get();
+		list.clear(Point((lo.x + hi.x) * 0.5, (lo.y + hi.y) * 0.5, (lo.z + hi.z) * 0.5));
+		collect(lo, hi, list);
+		unsigned padded = list.pad();
+
+		for (uint32_t j = group.begin; j < group.end; ++j) {
+			const LinearNode& n = (*tree)[j];
+			if (n.isCell())
+				continue;
+			Body& body = tree->base[n.body];
+
+			// backup previous acceleration and initialize new accel to 0
+			Point acc = body.acc;
+			body.acc = Point();
+
+			kernel(list, padded, list.relative(body.pos), epssq, body.acc);
+
+			// compute new velocity
+			body.vel.x += (body.acc.x - acc.x) * dthf;
+			body.vel.y += (body.acc.y - acc.y) * dthf;
+			body.vel.z += (body.acc.z - acc.z) * dthf;
+		}
+
+		*tTraversalTotal += Galois::readTSC() - tTraversal;
+
+		comp->tick();
+	}
+
+	/**
+	 * Stackless walk over the flattened octree. A cell is accepted for the
+	 * whole group only if its distance to the nearest point of the box passes
+	 * the opening test, so it passes for every body in the box
+	 */
+	void collect(const Point& lo, const Point& hi, List& list) {
+		const LinearNode* nodes = &tree->nodes[0];
+		const uint32_t size = tree->size();
+
+		uint32_t i = 0;
+		while (i < size) {
+			const LinearNode& n = nodes[i];
+			__builtin_prefetch(&nodes[n.next]);
+
+			if (n.isCell()) {
+				double dx = std::max(0.0, std::max(lo.x - n.pos.x, n.pos.x - hi.x));
+				double dy = std::max(0.0, std::max(lo.y - n.pos.y, n.pos.y - hi.y));
+				double dz = std::max(0.0, std::max(lo.z - n.pos.z, n.pos.z - hi.z));
+				if (dx * dx + dy * dy + dz * dz < n.dsq) {
+					// too close to some body of the group, open the cell
+					++i;
+					continue;
+				}
+			}
+
+			list.push(n.pos, n.mass);
+			i = n.next;
+		}
+	}
+};
+
+typedef GroupComputeForcesOf<double> GroupComputeForces;
+typedef GroupComputeForcesOf<float> MixedGroupComputeForces;
+
+}//	namespace Barneshut
+
+#endif//___F_GROUP_COMPUTE_FORCES_H___
@@ -0,0 +1,128 @@
+#ifndef ___F_LINEAR_COMPUTE_FORCES_H___
+#define ___F_LINEAR_COMPUTE_FORCES_H___
+
+//	Libraries includes
+#include <Galois/Statistic.h>
+#include <Galois/Runtime/Progress.h>
+
+//	local includes
+#include "config.h"
+#include "Octree.h"
+#include "LinearOctree.h"
+
+namespace Barneshut {
+
+/**
+ * Same forces as CleanComputeForces, walking the flattened octree instead.
+ * The walk is a forward loop over the node array with no stack: a cell that is
+ * far enough is skipped over through its next index, otherwise its children
+ * are the nodes right after it.
+ */
+struct LinearComputeForces {
+	// Optimize runtime for no conflict case
+	typedef int tt_does_not_need_aborts;
+
+	const LinearOctree* tree;
+
+	double dthf;
+	double epssq;
+
+	Galois::CycleStatistic * const tTraversalTotal;
+	GaloisRuntime::Progress* comp;
+
+	LinearComputeForces(const LinearOctree* _tree, double _dthf, double _epssq, Galois::CycleStatistic * const _tTraversalTotal = NULL, GaloisRuntime::Progress* _comp = NULL)
+	: tree(_tree)
+	, dthf(_dthf)
+	, epssq(_epssq)
+	, tTraversalTotal(_tTraversalTotal)
+	, comp(_comp)
+	{ }
+
+	/**
+	 * Operator
+	 */
+	template<typename Context>
+	void operator()(Body* bb, Context&) {
+		Body& body = *bb;
+		unsigned long long tTraversal = Galois::readTSC();
+
+		// backup previous acceleration and initialize new accel to 0
+		Point acc = body.acc;
+		body.acc = Point();
+
+		// compute acceleration for this body
+		iterate(body, bb - tree->base);
+
+		// compute new velocity
+		for(int i = 0; i < 3; ++i)
+			body.vel[i] += (body.acc[i] - acc[i]) * dthf;
+
+		*tTraversalTotal += Galois::readTSC() - tTraversal;
+
+		comp->tick();
+	}
+
+	void iterate(Body& body, uint32_t self) {
+		const LinearNode* nodes = &tree->nodes[0];
+		const uint32_t size = tree->size();
+		double ax = 0.0, ay = 0.0, az = 0.0;
+		unsigned cost = 0;
+
+		uint32_t i = 0;
+		while (i < size) {
+			const LinearNode& n = nodes[i];
+			__builtin_prefetch(&nodes[n.next]);
+
+			double dx = n.pos.x - body.pos.x;
+			double dy = n.pos.y - body.pos.y;
+			double dz = n.pos.z - body.pos.z;
+			double dist_sq = dx * dx + dy * dy + dz * dz;
+
+			if (n.isCell() && dist_sq < n.dsq) {
+				if (n.body == LinearNode::Bucket) {
+					// too close, sum the bucket's bodies directly
+					for (uint32_t j = i + 1; j < n.next; ++j) {
+						const LinearNode& b = nodes[j];
+						if (b.body == self)
+							continue;
+						double bx = b.pos.x - body.pos.x;
+						double by = b.pos.y - body.pos.y;
+						double bz = b.pos.z - body.pos.z;
+						double bd = bx * bx + by * by + bz * bz + epssq;
+						double idr = 1 / sqrt(bd);
+						double scale = b.mass * idr * idr * idr;
+						ax += bx * scale;
+						ay += by * scale;
+						az += bz * scale;
+						++cost;
+					}
+					i = n.next;
+					continue;
+				}
+				// too close, open the cell
+				++i;
+				continue;
+			}
+
+			if (n.body != self) {
+				dist_sq += epssq;
+				double idr = 1 / sqrt(dist_sq);
+				double scale = n.mass * idr * idr * idr;
+				ax += dx * scale;
+				ay += dy * scale;
+				az += dz * scale;
+				++cost;
+			}
+			i = n.next;
+		}
+		body.cost = cost;
+
+		body.acc.x += ax;
+		body.acc.y += ay;
+		body.acc.z += az;
+	}
+};
+
+}//	namespace Barneshut
+
+#endif//___F_LINEAR_COMPUTE_FORCES_H___
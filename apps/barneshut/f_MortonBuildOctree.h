@@ -0,0 +1,276 @@
+#ifndef ___F_MORTON_BUILD_OCTREE_H___
+#define ___F_MORTON_BUILD_OCTREE_H___
+
+#include <vector>
+#include <new>
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+#include <Galois/Galois.h>
+#include <Galois/SpatialSort.h>
+#include <Galois/Runtime/mm/Mem.h>
+
+#include "Octree.h"
+#include "BoundingBox.h"
+#include "NodeArena.h"
+#include "utilities.h"
+#include "f_BuildOctree.h"
+
+namespace Barneshut {
+
+/**
+ * Builds the same Octree as BuildOctree from the bodies' Morton keys, with
+ * no pointer chasing and no atomics.
+ *
+ * Keys use 21 bits per axis inside the root cell, so their octal digits are
+ * the child indices along each body's path. Once the keys are sorted, every
+ * cell shows up as a run of adjacent keys sharing its prefix: the pair
+ * (i, i + 1) sharing delta_i digits opens the cells at depths
+ * (delta_{i-1}, delta_i]. Numbering those cells pair by pair is a preorder
+ * of the tree, so a prefix sum places them, and each cell's parent is found
+ * from the nearest pair on the left with a smaller delta. All of it runs in
+ * a few parallel passes over the bodies, O(n) with at most 22 levels.
+ *
+ * Cells live in one buffer, in depth-first order, kept across timesteps.
+ * Bodies that share a key are finished with the concurrent inserts of
+ * BuildOctree, below their depth 21 cell.
+ */
+class MortonBuildOctree {
+  static const int Depth = 21;
+  static const int Levels = Depth + 1;
+
+  Galois::SpatialSorter sorter;
+  std::vector<Body*> order;     // bodies by key
+  Body* base;
+  std::vector<int8_t> delta;    // common digits of the keys of i and i + 1
+  std::vector<uint32_t> first;  // first cell opened by pair i
+  std::vector<uint32_t> sums;   // [thread] cells opened
+  std::vector<int32_t> carry;   // [thread][level] last pair at level before the block
+  OctreeInternal* cells;
+  size_t capacity;
+
+  // common state of the passes
+  const uint64_t* keys;
+  size_t n;
+  Point center;
+  double radius;
+  NodeArena* arena;
+
+  struct BodyKey {
+    Point lo;
+    double scale;
+    BodyKey(const Point& _lo, double _scale) : lo(_lo), scale(_scale) { }
+    uint64_t operator()(const Body* b) const {
+      uint64_t key = 0;
+      for (int a = 0; a < 3; ++a) {
+        uint64_t q = static_cast<uint64_t>(std::max(0.0, (b->pos[a] - lo[a]) * scale));
+        key |= Galois::SpatialSortImpl::spread(std::min(q, (uint64_t) (1 << Depth) - 1)) << a;
+      }
+      return key;
+    }
+  };
+
+  static int digit(uint64_t key, int depth) {
+    return (key >> (3 * (Depth - 1 - depth))) & 7;
+  }
+
+  static size_t blockBegin(size_t n, unsigned tid, unsigned num) {
+    return n * tid / num;
+  }
+
+  // octal digits shared by two keys, using their low 63 bits
+  static int common(uint64_t a, uint64_t b) {
+    uint64_t x = a ^ b;
+    return x ? (__builtin_clzll(x) - 1) / 3 : Depth;
+  }
+
+  int left(size_t i) const { return i > 0 ? delta[i - 1] : -1; }
+  int right(size_t i) const { return i + 1 < n ? delta[i] : -1; }
+
+  // pass 1: deltas, cells opened and last pair at each level, per block
+  struct Prefix {
+    MortonBuildOctree* self;
+    Prefix(MortonBuildOctree* _self) : self(_self) { }
+    void operator()(unsigned tid, unsigned num) {
+      MortonBuildOctree& s = *self;
+      size_t begin = blockBegin(s.n, tid, num);
+      size_t end = blockBegin(s.n, tid + 1, num);
+      int32_t* last = &s.carry[Levels * tid];
+      std::fill(last, last + Levels, -1);
+
+      uint32_t sum = 0;
+      int l = begin > 0 ? common(s.keys[begin - 1], s.keys[begin]) : -1;
+      for (size_t i = begin; i < end; ++i) {
+        int r = -1;
+        if (i + 1 < s.n) {
+          r = s.delta[i] = common(s.keys[i], s.keys[i + 1]);
+          last[r] = i;
+        }
+        sum += std::max(0, std::max(0, r) - l);
+        l = r;
+      }
+      s.sums[tid] = sum;
+    }
+  };
+
+  // pass 2: numbers the cells and constructs them at their geometric center
+  struct Place {
+    MortonBuildOctree* self;
+    Place(MortonBuildOctree* _self) : self(_self) { }
+    void operator()(unsigned tid, unsigned num) {
+      MortonBuildOctree& s = *self;
+      size_t end = blockBegin(s.n, tid + 1, num);
+      uint32_t c = s.sums[tid];
+      for (size_t i = blockBegin(s.n, tid, num); i < end; ++i) {
+        s.first[i] = c;
+        int depth = std::max(0, s.left(i) + 1);
+        int last = std::max(0, s.right(i));
+        if (depth > last)
+          continue;
+
+        // walk down the body's path like the inserts would
+        Point pos(s.center);
+        double r = s.radius;
+        for (int d = 0; d < depth; ++d) {
+          r *= 0.5;
+          updateCenter(pos, digit(s.keys[i], d), r);
+        }
+        for (; depth <= last; ++depth) {
+          new (&s.cells[c++]) OctreeInternal(pos);
+          if (depth < Depth) {
+            r *= 0.5;
+            updateCenter(pos, digit(s.keys[i], depth), r);
+          }
+        }
+      }
+    }
+  };
+
+  // pass 3: hooks every cell and body under its parent
+  struct Link {
+    MortonBuildOctree* self;
+    Link(MortonBuildOctree* _self) : self(_self) { }
+    void operator()(unsigned tid, unsigned num) {
+      MortonBuildOctree& s = *self;
+      size_t end = blockBegin(s.n, tid + 1, num);
+      int32_t last[Levels];
+      std::copy(&s.carry[Levels * tid], &s.carry[Levels * (tid + 1)], last);
+      for (size_t i = blockBegin(s.n, tid, num); i < end; ++i) {
+        uint64_t key = s.keys[i];
+        int l = s.left(i);
+        int r = s.right(i);
+
+        // the cell at depth l holding both i - 1 and i, opened by the
+        // first pair of the run of deltas >= l that ends at i - 1
+        OctreeInternal* shared = NULL;
+        if (i > 0) {
+          last[l] = i - 1;
+          int32_t j = -1;
+          for (int u = 0; u < l; ++u)
+            j = std::max(j, last[u]);
+          ++j;
+          shared = &s.cells[s.first[j] + l - s.left(j) - 1];
+        }
+
+        // cells opened by pair i, one per level, each under the previous
+        OctreeInternal* parent = shared;
+        for (int depth = l + 1; depth <= r; ++depth) {
+          OctreeInternal* cell = &s.cells[s.first[i] + depth - l - 1];
+          if (parent) {
+            cell->octant = digit(key, depth - 1);
+            parent->child[cell->octant] = cell;
+          }
+          parent = cell;
+        }
+
+        // the body hangs off the deepest cell it shares with a neighbor
+        int depth = std::max(0, std::max(l, r));
+        OctreeInternal* cell = r > l ? parent : shared;
+        if (s.n == 1)
+          cell = &s.cells[0];
+        if (depth < Depth)
+          cell->child[digit(key, depth)] = s.order[i];
+        else
+          BuildOctree(cell, 0.0, s.arena).insert(s.order[i], cell, ldexp(s.radius, -Depth));
+      }
+    }
+  };
+
+public:
+  MortonBuildOctree() : base(NULL), cells(NULL), capacity(0) { }
+
+  ~MortonBuildOctree() {
+    if (cells)
+      GaloisRuntime::MM::largeFree(cells, capacity * sizeof(OctreeInternal));
+  }
+
+  /**
+   * Builds the tree of bodies inside box, returning its root. The cells stay
+   * valid until the next call; arena is only used for bodies sharing a key
+   */
+  OctreeInternal* operator()(Bodies& bodies, const BoundingBox& box, NodeArena* _arena) {
+    center = box.center();
+    radius = box.radius();
+    arena = _arena;
+    n = bodies.size();
+    if (n == 0) {
+      reserve(1);
+      return new (&cells[0]) OctreeInternal(center);
+    }
+
+    // the last order is still a permutation of the same bodies, and a
+    // nearly sorted one
+    if (order.size() != n || base != &bodies[0]) {
+      base = &bodies[0];
+      order.resize(n);
+      for (size_t i = 0; i < n; ++i)
+        order[i] = &bodies[i];
+    }
+    Point lo(center.x - radius, center.y - radius, center.z - radius);
+    double scale = radius > 0.0 ? (1 << Depth) / (2 * radius) : 0.0;
+    sorter.sortByKey(order.begin(), order.end(), BodyKey(lo, scale));
+    keys = sorter.sortedKeys();
+
+    unsigned nthreads = Galois::getActiveThreads();
+    delta.resize(n);
+    first.resize(n);
+    sums.resize(nthreads);
+    carry.resize(Levels * nthreads);
+    Galois::on_each(Prefix(this));
+
+    // cells are numbered block after block, and each block starts from
+    // the last pair at every level in the blocks before it
+    uint32_t total = 0;
+    std::vector<int32_t> last(Levels, -1);
+    for (unsigned t = 0; t < nthreads; ++t) {
+      uint32_t sum = sums[t];
+      sums[t] = total;
+      total += sum;
+      for (int v = 0; v < Levels; ++v) {
+        int32_t c = carry[Levels * t + v];
+        carry[Levels * t + v] = last[v];
+        last[v] = std::max(last[v], c);
+      }
+    }
+    reserve(total);
+
+    Galois::on_each(Place(this));
+    Galois::on_each(Link(this));
+    return &cells[0];
+  }
+
+private:
+  void reserve(size_t size) {
+    if (size <= capacity)
+      return;
+    if (cells)
+      GaloisRuntime::MM::largeFree(cells, capacity * sizeof(OctreeInternal));
+    capacity = std::max(size, capacity * 2);
+    cells = static_cast<OctreeInternal*>(GaloisRuntime::MM::largeAlloc(capacity * sizeof(OctreeInternal)));
+  }
+};
+
+}
+
+#endif//___F_MORTON_BUILD_OCTREE_H___
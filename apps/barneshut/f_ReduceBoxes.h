@@ -1,25 +1,40 @@
 #ifndef ___F_REDUCE_BOXES_H___
 #define ___F_REDUCE_BOXES_H___
 
+#include <Galois/Accumulator.h>
+
 #include "BoundingBox.h"
 
 namespace Barneshut {
 
+/**
+ * Reduction operator for per thread bounding boxes
+ */
+struct MergeBoxes {
+	void operator()(BoundingBox& lhs, const BoundingBox& rhs) const {
+		lhs.merge(rhs);
+	}
+};
+
+typedef Galois::GReducible<BoundingBox, MergeBoxes> ReducibleBox;
+
 /**
  * Functor
  *
- * Merges each body's position with current bounding box to generate the global bounding box
+ * Merges each body's position with the current thread's bounding box.
+ * Partial boxes are merged into the global bounding box when the loop exits
  */
 struct ReduceBoxes {
-	// NB: only correct when run sequentially or tree-like reduction
+	// Optimize runtime for no conflict case
+	typedef int tt_does_not_need_aborts;
 	typedef int tt_does_not_need_stats;
-	BoundingBox& initial;
+	ReducibleBox& result;
 
-	ReduceBoxes(BoundingBox& _initial): initial(_initial) { }
+	ReduceBoxes(ReducibleBox& _result): result(_result) { }
 
 	template<typename Context>
 		void operator()(Body* b, Context&) {
-			initial.merge(b->pos);
+			result.get().merge(b->pos);
 		}
 };
 
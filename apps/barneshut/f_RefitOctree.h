@@ -0,0 +1,241 @@
+#ifndef ___F_REFIT_OCTREE_H___
+#define ___F_REFIT_OCTREE_H___
+
+#include <vector>
+#include <cmath>
+
+#include <Galois/Galois.h>
+#include <Galois/Runtime/PerCPU.h>
+
+#include "Octree.h"
+#include "BoundingBox.h"
+#include "NodeArena.h"
+#include "utilities.h"
+#include "f_BuildOctree.h"
+
+namespace Barneshut {
+
+/**
+ * Keeps the octree of the previous step instead of building a new one.
+ *
+ * Every cell gets its geometric center back and its children are put back
+ * in octant order. A body still inside its cell stays where it is; the
+ * others are taken out and inserted again from the root with BuildOctree,
+ * and cells left empty are dropped on the next refit. Buckets keep the
+ * bodies still inside them, in any order. The masses are then
+ * recomputed as usual by ComputeCenterOfMass.
+ *
+ * Leaf cells are small enough that most bodies leave theirs every step, so
+ * only bodies that also left the cell Slack levels above count as far
+ * moves, which decide when to rebuild.
+ *
+ * The tree's nodes must come from their own arena, only reset when the tree
+ * is rebuilt. The fix up pass is parallel below the same cutoff depth as
+ * ComputeCenterOfMass.
+ */
+class RefitOctree {
+public:
+  // subtree below the cut, waiting to be fixed
+  struct Task {
+    OctreeInternal* cell;
+    Point center;
+    double radius;
+    Task(OctreeInternal* _cell, const Point& _center, double _radius) : cell(_cell), center(_center), radius(_radius) { }
+  };
+
+  struct Fix {
+    typedef int tt_does_not_need_aborts;
+    typedef int tt_does_not_need_stats;
+    RefitOctree* self;
+    Fix(RefitOctree* _self) : self(_self) { }
+
+    template<typename Context>
+    void operator()(const Task& t, Context&) {
+      self->fix(t.cell, t.center, t.radius, ~0u, NULL);
+    }
+  };
+
+  //! Levels above its leaf cell a body may move within and not count as far
+  static const unsigned Slack = 5;
+
+private:
+  NodeArena* arena;
+  unsigned bucket_size;
+  OctreeInternal* root;
+  Point center;
+  double radius;
+  double cells_per_body; // right after the last build, 0 until summarized
+  GaloisRuntime::PerCPU<std::vector<Body*> > moved;
+  GaloisRuntime::PerCPU<size_t> far;
+  GaloisRuntime::PerCPU<size_t> kept; // cells the fix up went through
+  std::vector<Body*> reinsert;
+  unsigned cutoff;
+
+  static bool inside(const Point& p, const Point& c, double r) {
+    return fabs(p.x - c.x) <= r && fabs(p.y - c.y) <= r && fabs(p.z - c.z) <= r;
+  }
+
+  //! Whether p is inside the cell Slack levels above the cell at c of radius r
+  bool near(const Point& p, const Point& c, double r) const {
+    double ar = r * (1 << Slack);
+    if (ar >= radius)
+      return true;
+    for (int i = 0; i < 3; ++i) {
+      double lo = center[i] - radius;
+      double ac = lo + (floor((c[i] - lo) / (2 * ar)) + 0.5) * (2 * ar);
+      if (fabs(p[i] - ac) > ar)
+        return false;
+    }
+    return true;
+  }
+
+  /**
+   * Puts the children of cell back in their octants, taking out the bodies
+   * that left it. When tasks is given, cells at the cutoff depth are queued
+   */
+  void fix(OctreeInternal* cell, const Point& c, double r, unsigned levels, std::vector<Task>* tasks) {
+    cell->pos = c;
+    ++kept.get();
+    Octree* old[8];
+    std::copy(cell->child, cell->child + 8, old);
+    std::fill(cell->child, cell->child + 8, static_cast<Octree*>(NULL));
+
+    std::vector<Body*>& out = moved.get();
+    size_t& outFar = far.get();
+    if (cell->bucket) {
+      int index = 0;
+      for (int i = 0; i < 8 && old[i]; ++i) {
+        Body* b = static_cast<Body*>(old[i]);
+        if (inside(b->pos, c, r)) {
+          cell->child[index++] = b;
+        } else {
+          out.push_back(b);
+          outFar += !near(b->pos, c, r);
+        }
+      }
+      return;
+    }
+
+    // cells first, a body cannot take the octant of a cell
+    for (int i = 0; i < 8; ++i) {
+      if (old[i] == NULL || old[i]->isLeaf())
+        continue;
+      OctreeInternal* n = static_cast<OctreeInternal*>(old[i]);
+      if (n->nbodies > 0)
+        cell->child[n->octant] = n;
+    }
+
+    for (int i = 0; i < 8; ++i) {
+      if (old[i] == NULL || !old[i]->isLeaf())
+        continue;
+      Body* b = static_cast<Body*>(old[i]);
+      if (inside(b->pos, c, r)) {
+        int index = getIndex(c, b->pos);
+        if (cell->child[index] == NULL) {
+          cell->child[index] = b;
+          continue;
+        }
+      }
+      out.push_back(b);
+      outFar += !near(b->pos, c, r);
+    }
+
+    for (int i = 0; i < 8; ++i) {
+      Octree* child = cell->child[i];
+      if (child == NULL || child->isLeaf())
+        continue;
+      Point p(c);
+      updateCenter(p, i, r * 0.5);
+      OctreeInternal* n = static_cast<OctreeInternal*>(child);
+      if (tasks && levels == 1)
+        tasks->push_back(Task(n, p, r * 0.5));
+      else
+        fix(n, p, r * 0.5, levels - 1, tasks);
+    }
+  }
+
+public:
+  RefitOctree(NodeArena* _arena, unsigned _bucket_size = 1) :
+    arena(_arena),
+    bucket_size(_bucket_size),
+    root(NULL),
+    radius(0.0),
+    cells_per_body(0.0),
+    cutoff(parallelCutoff(Galois::getActiveThreads())) { }
+
+  OctreeInternal* top() const {
+    return root;
+  }
+
+  //! The root cell
+  BoundingBox cube() const {
+    BoundingBox b(center);
+    b.grow(radius);
+    return b;
+  }
+
+  /**
+   * Remembers a freshly built tree whose root cell is the cube around box
+   */
+  void built(OctreeInternal* top, const BoundingBox& box) {
+    root = top;
+    center = box.center();
+    radius = box.radius();
+    cells_per_body = 0.0;
+  }
+
+  //! Forgets the tree, so the next refit asks for a new one
+  void drop() {
+    root = NULL;
+  }
+
+  /**
+   * Refits the tree to bodies now inside box. Returns false, leaving the
+   * tree unusable, when it has to be rebuilt instead: some body left the
+   * root cell, more than max_moved of the bodies made far moves, or the
+   * cells kept have grown past max_growth per body of the last build
+   */
+  bool operator()(const BoundingBox& box, double max_moved, double max_growth) {
+    if (root == NULL || root->nbodies == 0)
+      return false;
+    if (!inside(box.min, center, radius) || !inside(box.max, center, radius))
+      return false;
+
+    if (cells_per_body == 0.0)
+      cells_per_body = (root->size - root->nbodies) / (double) root->nbodies;
+    unsigned nbodies = root->nbodies;
+
+    typedef GaloisRuntime::WorkList::dChunkedLIFO<1> WL;
+    std::vector<Task> tasks;
+    fix(root, center, radius, cutoff, &tasks);
+    Galois::for_each<WL>(tasks.begin(), tasks.end(), Fix(this));
+
+    reinsert.clear();
+    size_t farMoves = 0, cells = 0;
+    for (unsigned i = 0; i < moved.size(); ++i) {
+      std::vector<Body*>& m = moved.get(i);
+      reinsert.insert(reinsert.end(), m.begin(), m.end());
+      m.clear();
+      farMoves += far.get(i);
+      far.get(i) = 0;
+      cells += kept.get(i);
+      kept.get(i) = 0;
+    }
+    // the cells emptied by this step's moves are gone by now
+    if (farMoves > max_moved * nbodies || cells > cells_per_body * max_growth * nbodies)
+      return false;
+
+    typedef GaloisRuntime::WorkList::dChunkedLIFO<256> BodyWL;
+    Galois::for_each<BodyWL>(reinsert.begin(), reinsert.end(), BuildOctree(root, radius, arena, bucket_size));
+    return true;
+  }
+
+  //! Bodies inserted again by the last refit
+  size_t moves() const {
+    return reinsert.size();
+  }
+};
+
+}
+
+#endif//___F_REFIT_OCTREE_H___
@@ -0,0 +1,132 @@
+#ifndef ___F_SIMD_COMPUTE_FORCES_H___
+#define ___F_SIMD_COMPUTE_FORCES_H___
+
+//	Libraries includes
+#include <Galois/Statistic.h>
+#include <Galois/Runtime/Progress.h>
+#include <Galois/Runtime/PerCPU.h>
+
+//	local includes
+#include "config.h"
+#include "Octree.h"
+#include "LinearOctree.h"
+#include "InteractionList.h"
+
+namespace Barneshut {
+
+typedef GaloisRuntime::PerCPU<InteractionList> InteractionLists;
+typedef GaloisRuntime::PerCPU<MixedInteractionList> MixedInteractionLists;
+
+/**
+ * Same forces as LinearComputeForces, in two phases: the walk over the
+ * flattened octree only gathers the accepted nodes into the thread's
+ * interaction list, which is then summed by a vectorized kernel.
+ *
+ * Scalar is the precision of the interactions; the list is taken around
+ * the body, so float only rounds positions relative to it.
+ */
+template<typename Scalar>
+struct SimdComputeForcesOf {
+	// Optimize runtime for no conflict case
+	typedef int tt_does_not_need_aborts;
+
+	typedef InteractionListOf<Scalar> List;
+	typedef GaloisRuntime::PerCPU<List> Lists;
+	typedef typename ForceKernelOf<Scalar>::type Kernel;
+
+	const LinearOctree* tree;
+	Lists* lists;
+	Kernel kernel;
+
+	double dthf;
+	double epssq;
+
+	Galois::CycleStatistic * const tTraversalTotal;
+	GaloisRuntime::Progress* comp;
+
+	SimdComputeForcesOf(const LinearOctree* _tree, Lists* _lists, Kernel _kernel, double _dthf, double _epssq, Galois::CycleStatistic * const _tTraversalTotal = NULL, GaloisRuntime::Progress* _comp = NULL)
+	: tree(_tree)
+	, lists(_lists)
+	, kernel(_kernel)
+	, dthf(_dthf)
+	, epssq(_epssq)
+	, tTraversalTotal(_tTraversalTotal)
+	, comp(_comp)
+	{ }
+
+	/**
+	 * Operator
+	 */
+	template<typename Context>
+	void operator()(Body* bb, Context&) {
+		Body& body = *bb;
+		unsigned long long tTraversal = Galois::readTSC();
+
+		// backup previous acceleration and initialize new accel to 0
+		Point acc = body.acc;
+		body.acc = Point();
+
+		// compute acceleration for this body
+		List& list = lists->get();
+		collect(body, bb - tree->base, list);
+		body.cost = list.count;
+		if (list.count > 0)
+			kernel(list, list.pad(), Point(), epssq, body.acc);
+
+		// compute new velocity
+		body.vel.x += (body.acc.x - acc.x) * dthf;
+		body.vel.y += (body.acc.y - acc.y) * dthf;
+		body.vel.z += (body.acc.z - acc.z) * dthf;
+
+		*tTraversalTotal += Galois::readTSC() - tTraversal;
+
+		comp->tick();
+	}
+
+	/**
+	 * Phase one: the stackless walk of LinearComputeForces, pushing every
+	 * node it would interact with
+	 */
+	void collect(const Body& body, uint32_t self, List& list) {
+		const LinearNode* nodes = &tree->nodes[0];
+		const uint32_t size = tree->size();
+		list.clear(body.pos);
+
+		uint32_t i = 0;
+		while (i < size) {
+			const LinearNode& n = nodes[i];
+			__builtin_prefetch(&nodes[n.next]);
+
+			if (n.isCell()) {
+				double dx = n.pos.x - body.pos.x;
+				double dy = n.pos.y - body.pos.y;
+				double dz = n.pos.z - body.pos.z;
+				if (dx * dx + dy * dy + dz * dz < n.dsq) {
+					if (n.body == LinearNode::Bucket) {
+						// too close, push the bucket's bodies in one go
+						for (uint32_t j = i + 1; j < n.next; ++j) {
+							if (nodes[j].body != self)
+								list.push(nodes[j].pos, nodes[j].mass);
+						}
+						i = n.next;
+						continue;
+					}
+					// too close, open the cell
+					++i;
+					continue;
+				}
+			}
+
+			if (n.body != self)
+				list.push(n.pos, n.mass);
+			i = n.next;
+		}
+	}
+};
+
+typedef SimdComputeForcesOf<double> SimdComputeForces;
+typedef SimdComputeForcesOf<float> MixedSimdComputeForces;
+
+}//	namespace Barneshut
+
+#endif//___F_SIMD_COMPUTE_FORCES_H___
@@ -0,0 +1,17 @@
+#ifndef ___SORTING_TRAITS_H___
+#define ___SORTING_TRAITS_H___
+
+#include "Octree.h"
+
+namespace Barneshut {
+	/**
+	 * Coordinates used by Galois::SpatialSorter to order bodies
+	 */
+	struct BodyCoordinates {
+		double operator()(const Body& b, int axis) const {
+			return b.pos[axis];
+		}
+	};
+}
+
+#endif//___SORTING_TRAITS_H___
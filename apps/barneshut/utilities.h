@@ -1,19 +1,18 @@
 #ifndef ___UTILITIES_H___
 #define ___UTILITIES_H___
 
+#include <cmath>
+#include <boost/math/constants/constants.hpp>
+
+#include <Galois/Galois.h>
 #include <Galois/Runtime/ll/TID.h>
+#include <Galois/util/Philox.h>
 
 namespace Barneshut {
 	typedef std::vector<Body>   Bodies;
 	typedef std::vector<Body*>  BodiesPtr;
 	typedef std::vector<BodiesPtr*> BodyBlocks;
 
-	inline
-	unsigned long getTID() { return GaloisRuntime::LL::getTID(); }
-
-	inline
-	double nextDouble() { return rand() / (double) RAND_MAX; }
-
 	/**
 	 * Bitwise stuff
 	 * index initial: 000 (em binário)
@@ -53,53 +52,81 @@ namespace Barneshut {
 
 
 	/**
-	 * Generates random input according to the Plummer model, which is more
-	 * realistic but perhaps not so much so according to astrophysicists
+	 * Depth of the octree at which to cut it into independent subtrees for
+	 * parallel passes: about 16 subtrees per thread, assuming a full tree
 	 */
-	void generateInput(Bodies& bodies, int nbodies, int seed) {
+	inline unsigned parallelCutoff(unsigned threads) {
+		unsigned subtrees = 16 * threads;
+		unsigned cutoff = 1;
+		for (unsigned n = 8; n < subtrees; n *= 8)
+			cutoff++;
+		return cutoff;
+	}
+
+
+
+	/**
+	 * Body index of a random input according to the Plummer model, which is more
+	 * realistic but perhaps not so much so according to astrophysicists.
+	 * It only draws from the Philox stream of (seed, index)
+	 */
+	inline void plummerBody(Body& b, int index, int nbodies, unsigned seed) {
+		Galois::Philox rng(seed, index);
 		double v, sq, scale;
 		Point p;
 		double PI = boost::math::constants::pi<double>();
 
-		srand(seed);
-
 		double rsc = (3 * PI) / 16;
 		double vsc = sqrt(1.0 / rsc);
 
-		int nextId = 0;
-
-		for (int body = 0; body < nbodies; body++) {
-			double r = 1.0 / sqrt(pow(nextDouble() * 0.999, -2.0 / 3.0) - 1);
-			do {
-				for (int i = 0; i < 3; i++)
-					p[i] = nextDouble() * 2.0 - 1.0;
-				sq = p.x * p.x + p.y * p.y + p.z * p.z;
-			} while (sq > 1.0);
-			scale = rsc * r / sqrt(sq);
-
-			Body b;
-			b.mass = 1.0 / nbodies;
+		double r = 1.0 / sqrt(pow(rng.nextDouble() * 0.999, -2.0 / 3.0) - 1);
+		do {
 			for (int i = 0; i < 3; i++)
-				b.pos[i] = p[i] * scale;
-
-			do {
-				p.x = nextDouble();
-				p.y = nextDouble() * 0.1;
-			} while (p.y > p.x * p.x * pow(1 - p.x * p.x, 3.5));
-			v = p.x * sqrt(2.0 / sqrt(1 + r * r));
-			do {
-				for (int i = 0; i < 3; i++)
-					p[i] = nextDouble() * 2.0 - 1.0;
-				sq = p.x * p.x + p.y * p.y + p.z * p.z;
-			} while (sq > 1.0);
-			scale = vsc * v / sqrt(sq);
+				p[i] = rng.nextDouble() * 2.0 - 1.0;
+			sq = p.x * p.x + p.y * p.y + p.z * p.z;
+		} while (sq > 1.0);
+		scale = rsc * r / sqrt(sq);
+
+		b.id = index;
+		b.mass = 1.0 / nbodies;
+		for (int i = 0; i < 3; i++)
+			b.pos[i] = p[i] * scale;
+
+		do {
+			p.x = rng.nextDouble();
+			p.y = rng.nextDouble() * 0.1;
+		} while (p.y > p.x * p.x * pow(1 - p.x * p.x, 3.5));
+		v = p.x * sqrt(2.0 / sqrt(1 + r * r));
+		do {
 			for (int i = 0; i < 3; i++)
-				b.vel[i] = p[i] * scale;
+				p[i] = rng.nextDouble() * 2.0 - 1.0;
+			sq = p.x * p.x + p.y * p.y + p.z * p.z;
+		} while (sq > 1.0);
+		scale = vsc * v / sqrt(sq);
+		for (int i = 0; i < 3; i++)
+			b.vel[i] = p[i] * scale;
+	}
 
-			bodies.push_back(b);
-			b.id = nextId;
-			nextId++;
+	// one contiguous block of bodies per thread
+	struct GenerateInput {
+		Bodies* bodies;
+		unsigned seed;
+		GenerateInput(Bodies* _bodies, unsigned _seed) : bodies(_bodies), seed(_seed) { }
+		void operator()(unsigned tid, unsigned num) {
+			size_t n = bodies->size();
+			size_t end = n * (tid + 1) / num;
+			for (size_t i = n * tid / num; i < end; ++i)
+				plummerBody((*bodies)[i], i, n, seed);
 		}
+	};
+
+	/**
+	 * Generates nbodies Plummer model bodies in parallel. The input only
+	 * depends on the seed, not on the number of threads
+	 */
+	void generateInput(Bodies& bodies, int nbodies, int seed) {
+		bodies.resize(nbodies);
+		Galois::on_each(GenerateInput(&bodies, seed));
 	}
 }
 
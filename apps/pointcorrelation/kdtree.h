@@ -7,6 +7,7 @@ using std::vector;
 
 // Library includes
 #include <Galois/Accumulator.h>
+#include <Galois/Statistic.h>
 
 #include "kdtree-node.h"
 
@@ -19,76 +20,20 @@ struct KdTree {
 		const double radius;
 
 		//	for average time per point
-		Galois::GAccumulator<unsigned long> * const tTraversalTotal;
+		Galois::CycleStatistic * const tTraversalTotal;
 
-		//	PAPI data
-		std::string papiEventName;
-		Galois::GAccumulator<long long int> * const papiValueTotal;
-
-		Correlator (const KdTree& _tree, const double _radius, Galois::GAccumulator<unsigned long> * const _tTraversalTotal, const std::string& _papiEventName = "", Galois::GAccumulator<long long int> * const _papiValueTotal = NULL)
+		Correlator (const KdTree& _tree, const double _radius, Galois::CycleStatistic * const _tTraversalTotal)
 		: tree(_tree)
 		, radius(_radius)
 		, tTraversalTotal(_tTraversalTotal)
-		, papiEventName(_papiEventName)
-		, papiValueTotal(_papiValueTotal)
 		{}
 
 		//	Galois functor
 		template<typename Context>
 		void operator() (Point<K>** p, Context&) {
-			Galois::StatTimer tTraversal;
-			if (!papiEventName.empty()) {
-#ifndef NDEBUG
-				int eventSet = PAPI_NULL;
-				assert(PAPI_create_eventset(&eventSet) == PAPI_OK);
-
-				int event;
-				char * name = strdup(papiEventName.c_str());
-				assert(PAPI_event_name_to_code(name, &event) == PAPI_OK);
-				free(name);
-
-				assert(PAPI_add_event(eventSet, event) == PAPI_OK);
-
-				long long int value;
-
-				assert(PAPI_start(eventSet) == PAPI_OK);
-#else
-				int eventSet = PAPI_NULL;
-				PAPI_create_eventset(&eventSet);
-				int event;
-				char * name = strdup(papiEventName.c_str());
-				PAPI_event_name_to_code(name, &event);
-				free(name);
-				PAPI_add_event(eventSet, event);
-				long long int value;
-				PAPI_start(eventSet);
-#endif
-				
-				tTraversal.start();
-				count.get() += tree.correlated(**p, radius);
-				tTraversal.stop();
-				tTraversalTotal->get() += tTraversal.get_usec();
-
-#ifndef NDEBUG
-				assert(PAPI_stop(eventSet, &value) == PAPI_OK);
-
-				//	gather values
-				papiValueTotal->get() += value;
-
-				assert(PAPI_cleanup_eventset(eventSet) == PAPI_OK);
-				assert(PAPI_destroy_eventset(&eventSet) == PAPI_OK);
-#else
-				PAPI_stop(eventSet, &value);
-				papiValueTotal->get() += value;
-				PAPI_cleanup_eventset(eventSet);
-				PAPI_destroy_eventset(&eventSet);
-#endif
-			} else {
-				tTraversal.start();
-				count.get() += tree.correlated(**p, radius);
-				tTraversal.stop();
-				tTraversalTotal->get() += tTraversal.get_usec();
-			}
+			unsigned long long tTraversal = Galois::readTSC();
+			count.get() += tree.correlated(**p, radius);
+			*tTraversalTotal += Galois::readTSC() - tTraversal;
 		}
 	};
 
@@ -97,75 +42,20 @@ struct KdTree {
 		const double radius;
 
 		//	for average time per point
-		Galois::GAccumulator<unsigned long> * const tTraversalTotal;
-
-		//	PAPI data
-		std::string papiEventName;
-		Galois::GAccumulator<long long int> * const papiValueTotal;
+		Galois::CycleStatistic * const tTraversalTotal;
 
-		BlockedCorrelator (const KdTree& _tree, const double _radius, Galois::GAccumulator<unsigned long> * const _tTraversalTotal, const std::string& _papiEventName = "", Galois::GAccumulator<long long int> * const _papiValueTotal = NULL)
+		BlockedCorrelator (const KdTree& _tree, const double _radius, Galois::CycleStatistic * const _tTraversalTotal)
 		: tree(_tree)
 		, radius(_radius)
 		, tTraversalTotal(_tTraversalTotal)
-		, papiEventName(_papiEventName)
-		, papiValueTotal(_papiValueTotal)
 		{}
 
 		//	Galois functor
 		template<typename Context>
 		void operator() (vector<Point<K>*>* b, Context&) {
-			Galois::StatTimer tTraversal;
-			if (!papiEventName.empty()) {
-#ifndef NDEBUG
-				int eventSet = PAPI_NULL;
-				assert(PAPI_create_eventset(&eventSet) == PAPI_OK);
-
-				int event;
-				char * name = strdup(papiEventName.c_str());
-				assert(PAPI_event_name_to_code(name, &event) == PAPI_OK);
-				free(name);
-
-				assert(PAPI_add_event(eventSet, event) == PAPI_OK);
-
-				long long int value;
-				assert(PAPI_start(eventSet) == PAPI_OK);
-#else
-				int eventSet = PAPI_NULL;
-				PAPI_create_eventset(&eventSet);
-				int event;
-				char * name = strdup(papiEventName.c_str());
-				PAPI_event_name_to_code(name, &event);
-				free(name);
-				PAPI_add_event(eventSet, event);
-				long long int value;
-				PAPI_start(eventSet);
-#endif
-
-				tTraversal.start();
-				count.get() += tree.correlated(*b, radius);
-				tTraversal.stop();
-				tTraversalTotal->get() += tTraversal.get_usec();
-
-#ifndef NDEBUG
-				assert(PAPI_stop(eventSet, &value) == PAPI_OK);
-
-				//	gather values
-				papiValueTotal->get() += value;
-
-				assert(PAPI_cleanup_eventset(eventSet) == PAPI_OK);
-				assert(PAPI_destroy_eventset(&eventSet) == PAPI_OK);
-#else
-				PAPI_stop(eventSet, &value);
-				papiValueTotal->get() += value;
-				PAPI_cleanup_eventset(eventSet);
-				PAPI_destroy_eventset(&eventSet);
-#endif
-			} else {
-				tTraversal.start();
-				count.get() += tree.correlated(*b, radius);
-				tTraversal.stop();
-				tTraversalTotal->get() += tTraversal.get_usec();
-			}
+			unsigned long long tTraversal = Galois::readTSC();
+			count.get() += tree.correlated(*b, radius);
+			*tTraversalTotal += Galois::readTSC() - tTraversal;
 		}
 	};
 
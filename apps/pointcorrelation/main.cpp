@@ -17,11 +17,11 @@ using std::vector;
 #include <Lonestar/BoilerPlate.h>
 #include <Galois/Galois.h>
 #include <Galois/Statistic.h>
-#include <CGAL/spatial_sort.h>
-#include <papi.h>
+#include <Galois/SpatialSort.h>
+#include <Galois/Runtime/PerfCounters.h>
 
 // local includes
-#include "cgal.h"
+#include "sorting_traits.h"
 #include "point.h"
 #include "kdtree.h"
 #include "utilities.h"
@@ -40,22 +40,23 @@ static llvm::cl::opt<unsigned> seed("seed", llvm::cl::desc("Pseudo-random number
 static llvm::cl::opt<unsigned> blocksize("bs", llvm::cl::desc("Block size (number of points to use in a block). Low values mean excessive number of instructions. High values exceed cache capacity."), llvm::cl::init(0));
 static llvm::cl::opt<bool> togglesort("sort", llvm::cl::desc("Toggle spatial sort."), llvm::cl::init(false));
 static llvm::cl::opt<bool> g("g", llvm::cl::desc("Toggle Galois."), llvm::cl::init(false));
-static llvm::cl::opt<string> papicn("papi", llvm::cl::desc("PAPI counter name."), llvm::cl::init(string("")));
+static llvm::cl::opt<string> papicn("papi", llvm::cl::desc("PAPI events to count in the correlation, separated by commas."), llvm::cl::init(string("")));
 
 #define DIM 3
 
 int main (int argc, char *argv[]) {
 	LonestarStart(argc, argv, name, desc, url);
 
+	vector<Point<DIM> > storage;
 	Point<DIM>::Block points;
 
 	std::cerr << "Using " << npoints << " points." << std::endl;
-	generateInput(points, npoints, seed);
+	generateInput(storage, points, npoints, seed);
 
 	//	Sort points
 	if (togglesort) {
 		std::cerr << "* Using sorted input." << std::endl;
-		CGAL::spatial_sort(points.begin(), points.end(), PointSpatialSortingTraits());
+		Galois::spatial_sort(points.begin(), points.end(), PointCoordinates());
 	}
 
 	KdTree<DIM> tree(points);
@@ -73,18 +74,10 @@ int main (int argc, char *argv[]) {
 	typedef Point<DIM>::Block Block;
 	vector<Block> blocks;
 
-	//	Prepare PAPI
-	long long int value;
-	if (!papicn.empty()) {
-		std::cerr << "* Using PAPI to measure counter [" << papicn << ']' << std::endl;
-#ifndef NDEBUG
-		assert(PAPI_library_init(PAPI_VER_CURRENT) == PAPI_VER_CURRENT);
-		assert(PAPI_thread_init(getTID) == PAPI_OK);
-#else
-		PAPI_library_init(PAPI_VER_CURRENT);
-		PAPI_thread_init(getTID);
-#endif
-	}
+	//	Prepare PAPI, one event set per thread
+	GaloisRuntime::PerfCounters counters(papicn, "Correlation");
+	if (counters.enabled())
+		std::cerr << "* Using PAPI to count [" << papicn << ']' << std::endl;
 
 	//	Split into blocks
 	if (b) {
@@ -102,108 +95,70 @@ int main (int argc, char *argv[]) {
 	//	two point correlation
 	if (g && b) {
 		//	Parallel (with Galois) and blocked
-		Galois::GAccumulator<unsigned long> tTraversalTotal;
-		tTraversalTotal.reset(0);
-		Galois::GAccumulator<long long int> papiValueTotal;
-		papiValueTotal.reset(0);
-		KdTree<DIM>::BlockedCorrelator correlator(tree, radius, &tTraversalTotal, papicn, &papiValueTotal);
+		Galois::CycleStatistic tTraversalTotal("TraversalTime");
+		KdTree<DIM>::BlockedCorrelator correlator(tree, radius, &tTraversalTotal);
 
 		tAlgorithm.start();
+		counters.start();
 		Galois::for_each(Point<DIM>::wrap(blocks.begin()), Point<DIM>::wrap(blocks.end()), correlator);
+		counters.stop();
 		tAlgorithm.stop();
 
 		//	average traversal time
-		tTraversalAvg = (double) tTraversalTotal.get() / (double) points.size();
+		tTraversalAvg = (double) tTraversalTotal.get_usec() / (double) points.size();
 
 		//	final correlation result
 		result = (count.get() - points.size()) / 2;
-
-		//	PAPI value
-		value = papiValueTotal.get();
 	} else if (g) {
 		//	Parallel (with Galois)
-		Galois::GAccumulator<unsigned long> tTraversalTotal;
-		tTraversalTotal.reset(0);
-		Galois::GAccumulator<long long int> papiValueTotal;
-		papiValueTotal.reset(0);
-		KdTree<DIM>::Correlator correlator(tree, radius, &tTraversalTotal, papicn, &papiValueTotal);
+		Galois::CycleStatistic tTraversalTotal("TraversalTime");
+		KdTree<DIM>::Correlator correlator(tree, radius, &tTraversalTotal);
 
 		tAlgorithm.start();
+		counters.start();
 		Galois::for_each(Point<DIM>::wrap(points.begin()), Point<DIM>::wrap(points.end()), correlator);
+		counters.stop();
 		tAlgorithm.stop();
 
 		//	average traversal time
-		tTraversalAvg = (double) tTraversalTotal.get() / (double) points.size();
+		tTraversalAvg = (double) tTraversalTotal.get_usec() / (double) points.size();
 
 		//	final correlation result
 		result = (count.get() - points.size()) / 2;
-
-		//	PAPI value
-		value = papiValueTotal.get();
 	} else if (b) {
 		result = 0;
 		tAlgorithm.start();
+		counters.start();
 		for (unsigned i = 0; i < blocks.size(); ++i)
 			result += tree.correlated(blocks[i], radius);
+		counters.stop();
 		tAlgorithm.stop();
 		result = (result - points.size()) / 2;
 	} else {
-		Galois::StatTimer tTraversal;
-		unsigned long tTraversalTotal = 0;
+		unsigned long long tTraversalTotal = 0;
 
 		result = 0;
 
-		if (!papicn.empty()) {
-			int eventSet = PAPI_NULL;
-			assert(PAPI_create_eventset(&eventSet) == PAPI_OK);
-
-			int event;
-			char * name = strdup(papicn.c_str());
-			assert(PAPI_event_name_to_code(name, &event) == PAPI_OK);
-			free(name);
-
-			assert(PAPI_add_event(eventSet, event) == PAPI_OK);
-			assert(PAPI_start(eventSet) == PAPI_OK);
-
-			tAlgorithm.start();
-			for (unsigned i = 0; i < points.size(); ++i) {
-				tTraversal.start();
-				result += tree.correlated(*points[i], radius);
-				tTraversal.stop();
-				tTraversalTotal += tTraversal.get_usec();
-			}
-			tAlgorithm.stop();
-
-			assert(PAPI_stop(eventSet, &value) == PAPI_OK);
-			assert(PAPI_cleanup_eventset(eventSet) == PAPI_OK);
-			assert(PAPI_destroy_eventset(&eventSet) == PAPI_OK);
-		} else {
-			tAlgorithm.start();
-			for (unsigned i = 0; i < points.size(); ++i) {
-				tTraversal.start();
-				result += tree.correlated(*points[i], radius);
-				tTraversal.stop();
-				tTraversalTotal += tTraversal.get_usec();
-			}
-			tAlgorithm.stop();
+		tAlgorithm.start();
+		counters.start();
+		for (unsigned i = 0; i < points.size(); ++i) {
+			unsigned long long tTraversal = Galois::readTSC();
+			result += tree.correlated(*points[i], radius);
+			tTraversalTotal += Galois::readTSC() - tTraversal;
 		}
+		counters.stop();
+		tAlgorithm.stop();
 
-		tTraversalAvg = (double) tTraversalTotal / (double) points.size();
+		tTraversalAvg = (double) Galois::TSCTimer::toUsec(tTraversalTotal) / (double) points.size();
 		result = (result - points.size()) / 2;
 	}
 	std::cerr << "\t\t" << (double) tAlgorithm.get_usec() * 1e-6 << " seconds" << std::endl;
 	std::cerr << "\t\t" << tTraversalAvg * 1e-3 << " miliseconds" << std::endl;
 	std::cout << result << std::endl;
 
-	//	Cleanup PAPI
-	if (!papicn.empty()) {
-		std::cerr << "- " << papicn << ":\t" << value << std::endl;
-		PAPI_shutdown();
-	}
-
-	//	CLEANUP
-	for (unsigned i = 0; i < points.size(); ++i)
-		delete points[i];
+	//	PAPI values
+	for (unsigned i = 0; i < counters.size(); ++i)
+		std::cerr << "- " << counters.name(i) << ":\t" << counters.total(i) << std::endl;
 
 	return 0;
 }
@@ -0,0 +1,16 @@
+#ifndef ___SORTING_TRAITS_H___
+#define ___SORTING_TRAITS_H___
+
+// local includes
+#include "point.h"
+
+/**
+ * Coordinates used by Galois::SpatialSorter to order points
+ */
+struct PointCoordinates {
+	double operator()(const Point<3>* p, int axis) const {
+		return (*p)[axis];
+	}
+};
+
+#endif//___SORTING_TRAITS_H___
@@ -0,0 +1,8 @@
+# Set PAPI_ROOT to look for PAPI somewhere else than the system paths
+find_path(PAPI_INCLUDE_DIRS papi.h PATHS ${PAPI_ROOT}/include)
+find_library(PAPI_LIBRARIES papi PATHS ${PAPI_ROOT}/lib)
+if(PAPI_INCLUDE_DIRS AND PAPI_LIBRARIES)
+  set(PAPI_FOUND_INTERNAL "YES")
+endif()
+
+find_package_handle_standard_args(PAPI DEFAULT_MSG PAPI_FOUND_INTERNAL)
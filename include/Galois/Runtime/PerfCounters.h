@@ -0,0 +1,110 @@
+/** Hardware performance counters -*- C++ -*-
+ * @file
+ * @section License
+ *
+ * Galois, a framework to exploit amorphous data-parallelism in irregular
+ * programs.
+ *
+ * Copyright (C) 2012, The University of Texas at Austin. All rights reserved.
+ * UNIVERSITY EXPRESSLY DISCLAIMS ANY AND ALL WARRANTIES CONCERNING THIS
+ * SOFTWARE AND DOCUMENTATION, INCLUDING ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR ANY PARTICULAR PURPOSE, NON-INFRINGEMENT AND WARRANTIES OF
+ * PERFORMANCE, AND ANY WARRANTY THAT MIGHT OTHERWISE ARISE FROM COURSE OF
+ * DEALING OR USAGE OF TRADE.  NO WARRANTY IS EITHER EXPRESS OR IMPLIED WITH
+ * RESPECT TO THE USE OF THE SOFTWARE OR DOCUMENTATION. Under no circumstances
+ * shall University be liable for incidental, special, indirect, direct or
+ * consequential damages or loss of profits, interruption of business, or
+ * related expenses which may arise from use of Software or Documentation,
+ * including but not limited to those resulting from defects in Software and/or
+ * Documentation, or loss or inaccuracy of data of any kind.
+ *
+ * @section Description
+ *
+ * Per-thread PAPI counters read around parallel loops.
+ */
+#ifndef GALOIS_RUNTIME_PERFCOUNTERS_H
+#define GALOIS_RUNTIME_PERFCOUNTERS_H
+
+#include "Galois/Runtime/PerThreadStorage.h"
+
+#include <string>
+#include <vector>
+
+namespace GaloisRuntime {
+
+/**
+ * Hardware counters read around parallel loops.
+ *
+ * Each thread gets one PAPI event set holding every event, created the first
+ * time it starts counting and kept until the counters are destroyed, so a
+ * loop only costs one start and one stop per thread. What a thread counts
+ * between start() and stop() is reported under loopname, one category per
+ * event, and added to the totals.
+ *
+ * Without PAPI (GALOIS_USE_PAPI) or with no events the counters are
+ * disabled and start() and stop() do nothing.
+ */
+class PerfCounters {
+  struct Local {
+    int eventSet;
+    bool failed;
+    std::vector<long long> totals;
+    Local(): eventSet(-1 /* PAPI_NULL */), failed(false) { }
+  };
+
+  struct Start {
+    PerfCounters* self;
+    Start(PerfCounters* s): self(s) { }
+    void operator()(unsigned, unsigned) { self->startLocal(); }
+  };
+
+  struct Stop {
+    PerfCounters* self;
+    Stop(PerfCounters* s): self(s) { }
+    void operator()(unsigned, unsigned) { self->stopLocal(); }
+  };
+
+  struct Destroy {
+    PerfCounters* self;
+    Destroy(PerfCounters* s): self(s) { }
+    void operator()(unsigned, unsigned) { self->destroyLocal(); }
+  };
+
+  std::string loopname;
+  std::vector<std::string> names;
+  std::vector<int> codes;
+  PerThreadStorage<Local> locals;
+  bool running;
+
+  void startLocal();
+  void stopLocal();
+  void destroyLocal();
+
+  PerfCounters(const PerfCounters&);
+  PerfCounters& operator=(const PerfCounters&);
+
+public:
+  //! events are PAPI event names separated by commas
+  PerfCounters(const std::string& events, const std::string& loopname);
+  ~PerfCounters();
+
+  bool enabled() const { return !codes.empty(); }
+
+  //! Number of events counted, 0 when disabled
+  unsigned size() const { return codes.size(); }
+
+  const std::string& name(unsigned i) const { return names[i]; }
+
+  //! Starts counting on every active thread
+  void start();
+
+  //! Stops counting and reports what each thread counted since start()
+  void stop();
+
+  //! Count of event i over every thread and loop so far
+  long long total(unsigned i);
+};
+
+}
+
+#endif
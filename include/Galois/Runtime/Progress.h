@@ -0,0 +1,93 @@
+/** Progress reporting -*- C++ -*-
+ * @file
+ * @section License
+ *
+ * Galois, a framework to exploit amorphous data-parallelism in irregular
+ * programs.
+ *
+ * Copyright (C) 2012, The University of Texas at Austin. All rights reserved.
+ * UNIVERSITY EXPRESSLY DISCLAIMS ANY AND ALL WARRANTIES CONCERNING THIS
+ * SOFTWARE AND DOCUMENTATION, INCLUDING ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR ANY PARTICULAR PURPOSE, NON-INFRINGEMENT AND WARRANTIES OF
+ * PERFORMANCE, AND ANY WARRANTY THAT MIGHT OTHERWISE ARISE FROM COURSE OF
+ * DEALING OR USAGE OF TRADE.  NO WARRANTY IS EITHER EXPRESS OR IMPLIED WITH
+ * RESPECT TO THE USE OF THE SOFTWARE OR DOCUMENTATION. Under no circumstances
+ * shall University be liable for incidental, special, indirect, direct or
+ * consequential damages or loss of profits, interruption of business, or
+ * related expenses which may arise from use of Software or Documentation,
+ * including but not limited to those resulting from defects in Software and/or
+ * Documentation, or loss or inaccuracy of data of any kind.
+ *
+ * @section Description
+ *
+ * Progress of a parallel loop, printed by a reporter thread.
+ */
+#ifndef GALOIS_RUNTIME_PROGRESS_H
+#define GALOIS_RUNTIME_PROGRESS_H
+
+#include "Galois/Runtime/PerThreadStorage.h"
+
+#include <pthread.h>
+#include <string>
+
+namespace GaloisRuntime {
+
+/**
+ * Progress of a loop, printed on stderr as "\r<label> done / total".
+ *
+ * A worker only bumps a counter of its own with a relaxed store in tick():
+ * no lock, no shared cache line and no output in the loop. A reporter
+ * thread, started with the first loop and kept until destruction, wakes up
+ * every interval milliseconds and rewrites the line when the count moved.
+ * stop() prints the final count and ends the line.
+ */
+class Progress {
+  struct Count {
+    unsigned long n;
+    Count(): n(0) { }
+  };
+
+  PerThreadStorage<Count> counts;
+  std::string label;
+  unsigned interval;
+  unsigned long total;
+  unsigned long printed;
+  bool active;
+  bool quit;
+  bool started;
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t wake;
+
+  static void* reporter(void* self);
+  unsigned long sum();
+  void print(unsigned long done);
+
+  Progress(const Progress&);
+  Progress& operator=(const Progress&);
+
+public:
+  Progress(const std::string& label, unsigned interval = 250);
+  ~Progress();
+
+  //! Starts reporting a loop of total items. Call between loops only
+  void start(unsigned long total);
+
+  //! Stops reporting and prints the final count
+  void stop();
+
+  //! Items done since start, summed over the threads
+  unsigned long count() {
+    return sum();
+  }
+
+  //! One more item done by this thread
+  void tick() {
+    Count& c = *counts.getLocal();
+    __atomic_store_n(&c.n, c.n + 1, __ATOMIC_RELAXED);
+  }
+};
+
+}
+
+#endif
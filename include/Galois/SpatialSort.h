@@ -0,0 +1,312 @@
+/** Parallel spatial sort -*- C++ -*-
+ * @file
+ * @section License
+ *
+ * Galois, a framework to exploit amorphous data-parallelism in irregular
+ * programs.
+ *
+ * Copyright (C) 2011, The University of Texas at Austin. All rights reserved.
+ * UNIVERSITY EXPRESSLY DISCLAIMS ANY AND ALL WARRANTIES CONCERNING THIS
+ * SOFTWARE AND DOCUMENTATION, INCLUDING ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR ANY PARTICULAR PURPOSE, NON-INFRINGEMENT AND WARRANTIES OF
+ * PERFORMANCE, AND ANY WARRANTY THAT MIGHT OTHERWISE ARISE FROM COURSE OF
+ * DEALING OR USAGE OF TRADE.  NO WARRANTY IS EITHER EXPRESS OR IMPLIED WITH
+ * RESPECT TO THE USE OF THE SOFTWARE OR DOCUMENTATION. Under no circumstances
+ * shall University be liable for incidental, special, indirect, direct or
+ * consequential damages or loss of profits, interruption of business, or
+ * related expenses which may arise from use of Software or Documentation,
+ * including but not limited to those resulting from defects in Software and/or
+ * Documentation, or loss or inaccuracy of data of any kind.
+ *
+ * Orders 3D elements along a Morton (Z-order) curve. Each coordinate is
+ * quantized to 21 bits inside the bounding box of the range, the interleaved
+ * 63 bit keys are ordered with a parallel LSD radix sort, and the elements are
+ * then permuted in parallel.
+ */
+#ifndef GALOIS_SPATIALSORT_H
+#define GALOIS_SPATIALSORT_H
+
+#include "Galois/Galois.h"
+#include "Galois/Runtime/mm/Mem.h"
+
+#include <boost/utility.hpp>
+
+#include <new>
+#include <vector>
+#include <limits>
+#include <iterator>
+#include <algorithm>
+#include <stdint.h>
+#include <cassert>
+
+namespace Galois {
+
+namespace SpatialSortImpl {
+
+//! Spreads the low 21 bits of v so that they land on every third bit
+inline uint64_t spread(uint64_t v) {
+  v &= 0x1fffff;
+  v = (v | v << 32) & 0x1f00000000ffffULL;
+  v = (v | v << 16) & 0x1f0000ff0000ffULL;
+  v = (v | v << 8) & 0x100f00f00f00f00fULL;
+  v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+  v = (v | v << 2) & 0x1249249249249249ULL;
+  return v;
+}
+
+//! Runs fn(tid, nthreads) on every thread, or inline when already in a loop
+template<typename FunctionTy>
+void run(FunctionTy& fn) {
+  if (GaloisRuntime::inGaloisForEach)
+    fn(0, 1);
+  else
+    Galois::on_each(fn);
+}
+
+inline size_t blockBegin(size_t n, unsigned tid, unsigned nthreads) {
+  return n * tid / nthreads;
+}
+
+}
+
+/**
+ * Reusable parallel spatial sort. Keeps its buffers between calls, so that
+ * sorting the same range every step allocates nothing after the first one.
+ *
+ * coords(v, axis) must return coordinate axis (0, 1 or 2) of element v.
+ * Elements need to be copy constructible and assignable.
+ */
+class SpatialSorter: private boost::noncopyable {
+  static const unsigned RadixBits = 8;
+  static const unsigned Buckets = 1 << RadixBits;
+  static const unsigned KeyBits = 63;
+
+  std::vector<uint64_t> keys[2];
+  std::vector<uint32_t> index[2];
+  std::vector<size_t> counts; // [thread][bucket]
+  std::vector<double> bounds; // [thread][min xyz, max xyz]
+  unsigned nthreads;
+  unsigned sorted; // buffer holding the last sorted keys
+  // elements in sorted order, constructed and destroyed by the permutation
+  char* perm;
+  size_t permBytes;
+
+  template<typename IterTy, typename CoordsTy>
+  struct Bounds {
+    SpatialSorter& s; IterTy b; size_t n; CoordsTy& coords;
+    Bounds(SpatialSorter& _s, IterTy _b, size_t _n, CoordsTy& _c): s(_s), b(_b), n(_n), coords(_c) { }
+    void operator()(unsigned tid, unsigned num) {
+      double* bb = &s.bounds[6 * tid];
+      for (int a = 0; a < 3; ++a) {
+        bb[a] = std::numeric_limits<double>::max();
+        bb[3 + a] = -std::numeric_limits<double>::max();
+      }
+      size_t end = SpatialSortImpl::blockBegin(n, tid + 1, num);
+      for (size_t i = SpatialSortImpl::blockBegin(n, tid, num); i < end; ++i) {
+        for (int a = 0; a < 3; ++a) {
+          double c = coords(b[i], a);
+          bb[a] = std::min(bb[a], c);
+          bb[3 + a] = std::max(bb[3 + a], c);
+        }
+      }
+    }
+  };
+
+  template<typename CoordsTy>
+  struct MortonKey {
+    CoordsTy& coords;
+    double lo[3]; double scale;
+    MortonKey(CoordsTy& _c): coords(_c) { }
+    template<typename T>
+    uint64_t operator()(const T& v) const {
+      uint64_t key = 0;
+      for (int a = 0; a < 3; ++a) {
+        uint64_t q = static_cast<uint64_t>((coords(v, a) - lo[a]) * scale);
+        key |= SpatialSortImpl::spread(q) << a;
+      }
+      return key;
+    }
+  };
+
+  template<typename IterTy, typename KeyTy>
+  struct Keys {
+    SpatialSorter& s; IterTy b; size_t n; KeyTy& key;
+    Keys(SpatialSorter& _s, IterTy _b, size_t _n, KeyTy& _k): s(_s), b(_b), n(_n), key(_k) { }
+    void operator()(unsigned tid, unsigned num) {
+      size_t end = SpatialSortImpl::blockBegin(n, tid + 1, num);
+      for (size_t i = SpatialSortImpl::blockBegin(n, tid, num); i < end; ++i) {
+        s.keys[0][i] = key(b[i]);
+        s.index[0][i] = i;
+      }
+    }
+  };
+
+  //! One radix digit: count (scatter false) or stable scatter (scatter true)
+  struct Pass {
+    SpatialSorter& s; size_t n; unsigned shift; unsigned from; bool scatter;
+    Pass(SpatialSorter& _s, size_t _n, unsigned _shift, unsigned _from, bool _scatter):
+      s(_s), n(_n), shift(_shift), from(_from), scatter(_scatter) { }
+    void operator()(unsigned tid, unsigned num) {
+      size_t* c = &s.counts[Buckets * tid];
+      const uint64_t* k = &s.keys[from][0];
+      size_t begin = SpatialSortImpl::blockBegin(n, tid, num);
+      size_t end = SpatialSortImpl::blockBegin(n, tid + 1, num);
+      if (!scatter) {
+        std::fill(c, c + Buckets, 0);
+        for (size_t i = begin; i < end; ++i)
+          ++c[(k[i] >> shift) & (Buckets - 1)];
+        return;
+      }
+      const uint32_t* idx = &s.index[from][0];
+      uint64_t* ko = &s.keys[1 - from][0];
+      uint32_t* io = &s.index[1 - from][0];
+      for (size_t i = begin; i < end; ++i) {
+        size_t pos = c[(k[i] >> shift) & (Buckets - 1)]++;
+        ko[pos] = k[i];
+        io[pos] = idx[i];
+      }
+    }
+  };
+
+  //! Copies the elements into tmp in sorted order, or back into the range
+  template<typename IterTy, typename T>
+  struct Permute {
+    IterTy b; size_t n; const uint32_t* idx; T* tmp; bool back;
+    Permute(IterTy _b, size_t _n, const uint32_t* _idx, T* _tmp, bool _back):
+      b(_b), n(_n), idx(_idx), tmp(_tmp), back(_back) { }
+    void operator()(unsigned tid, unsigned num) {
+      size_t end = SpatialSortImpl::blockBegin(n, tid + 1, num);
+      for (size_t i = SpatialSortImpl::blockBegin(n, tid, num); i < end; ++i) {
+        if (back) {
+          b[i] = tmp[i];
+          tmp[i].~T();
+        } else {
+          new (&tmp[i]) T(b[idx[i]]);
+        }
+      }
+    }
+  };
+
+  //! Sorts keys[0]/index[0], returning which buffer holds the result
+  unsigned radixSort(size_t n) {
+    unsigned cur = 0;
+    for (unsigned shift = 0; shift < KeyBits; shift += RadixBits) {
+      Pass count(*this, n, shift, cur, false);
+      SpatialSortImpl::run(count);
+
+      // turn counts into starting offsets, bucket-major then thread-major
+      size_t sum = 0;
+      bool trivial = false;
+      for (unsigned d = 0; d < Buckets; ++d) {
+        size_t bucket = 0;
+        for (unsigned t = 0; t < nthreads; ++t) {
+          size_t c = counts[Buckets * t + d];
+          counts[Buckets * t + d] = sum;
+          sum += c;
+          bucket += c;
+        }
+        if (bucket == n)
+          trivial = true;
+      }
+      // every key has the same digit, the order would not change
+      if (trivial)
+        continue;
+
+      Pass scatter(*this, n, shift, cur, true);
+      SpatialSortImpl::run(scatter);
+      cur = 1 - cur;
+    }
+    return cur;
+  }
+
+public:
+  SpatialSorter(): nthreads(1), sorted(0), perm(0), permBytes(0) { }
+
+  ~SpatialSorter() {
+    if (perm)
+      GaloisRuntime::MM::largeFree(perm, permBytes);
+  }
+
+  template<typename IterTy, typename CoordsTy>
+  void operator()(IterTy b, IterTy e, CoordsTy coords) {
+    size_t n = std::distance(b, e);
+    if (n < 2)
+      return;
+
+    nthreads = GaloisRuntime::inGaloisForEach ? 1 : Galois::getActiveThreads();
+    bounds.resize(6 * nthreads);
+    Bounds<IterTy, CoordsTy> bfn(*this, b, n, coords);
+    SpatialSortImpl::run(bfn);
+
+    // quantize every axis with the same scale, keeping the cells cubic
+    MortonKey<CoordsTy> key(coords);
+    double extent = 0.0;
+    for (int a = 0; a < 3; ++a) {
+      double lo = std::numeric_limits<double>::max();
+      double hi = -std::numeric_limits<double>::max();
+      for (unsigned t = 0; t < nthreads; ++t) {
+        lo = std::min(lo, bounds[6 * t + a]);
+        hi = std::max(hi, bounds[6 * t + 3 + a]);
+      }
+      key.lo[a] = lo;
+      extent = std::max(extent, hi - lo);
+    }
+    key.scale = extent > 0.0 ? ((1 << 21) - 1) / extent : 0.0;
+    sortByKey(b, e, key);
+  }
+
+  /**
+   * Sorts [b, e) by the 63 bit keys given by key(v), for callers that
+   * quantize the elements themselves. Equal keys keep their order.
+   */
+  template<typename IterTy, typename KeyTy>
+  void sortByKey(IterTy b, IterTy e, KeyTy key) {
+    typedef typename std::iterator_traits<IterTy>::value_type T;
+    size_t n = std::distance(b, e);
+    assert(n <= std::numeric_limits<uint32_t>::max());
+
+    nthreads = GaloisRuntime::inGaloisForEach ? 1 : Galois::getActiveThreads();
+    counts.resize(Buckets * nthreads);
+    for (int i = 0; i < 2; ++i) {
+      keys[i].resize(n);
+      index[i].resize(n);
+    }
+
+    Keys<IterTy, KeyTy> kfn(*this, b, n, key);
+    SpatialSortImpl::run(kfn);
+    sorted = 0;
+    if (n < 2)
+      return;
+
+    sorted = radixSort(n);
+
+    if (n * sizeof(T) > permBytes) {
+      if (perm)
+        GaloisRuntime::MM::largeFree(perm, permBytes);
+      permBytes = n * sizeof(T);
+      perm = static_cast<char*>(GaloisRuntime::MM::largeAlloc(permBytes));
+    }
+    T* tmp = reinterpret_cast<T*>(perm);
+    Permute<IterTy, T> gather(b, n, &index[sorted][0], tmp, false);
+    SpatialSortImpl::run(gather);
+    Permute<IterTy, T> put(b, n, NULL, tmp, true);
+    SpatialSortImpl::run(put);
+  }
+
+  //! Keys of the last sortByKey, in sorted order
+  const uint64_t* sortedKeys() const {
+    return &keys[sorted][0];
+  }
+};
+
+/**
+ * Sorts [b, e) along a Morton curve in parallel. See SpatialSorter
+ */
+template<typename IterTy, typename CoordsTy>
+void spatial_sort(IterTy b, IterTy e, CoordsTy coords) {
+  SpatialSorter sorter;
+  sorter(b, e, coords);
+}
+
+}
+#endif
@@ -55,6 +55,40 @@ namespace Galois {
     unsigned long get() const;
     TimeAccumulator& operator+=(const TimeAccumulator& rhs);
   };
+
+  //! Monotonic clock in nanoseconds, where there is no time stamp counter
+  unsigned long long readClock();
+
+  //! Reads the time stamp counter: a few cycles and no system call, cheap
+  //! enough to time every item of a hot loop.
+  inline unsigned long long readTSC() {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((unsigned long long) hi << 32) | lo;
+#else
+    return readClock();
+#endif
+  }
+
+  //! A timer on the time stamp counter, adding up intervals in cycles
+  class TSCTimer {
+    unsigned long long _start;
+    unsigned long long _total;
+  public:
+    TSCTimer(): _start(0), _total(0) { }
+    void start() { _start = readTSC(); }
+    //!adds the current timed interval to the total
+    void stop() { _total += readTSC() - _start; }
+    unsigned long long cycles() const { return _total; }
+    unsigned long get_usec() const { return toUsec(_total); }
+
+    //! Counter ticks per microsecond, measured once
+    static double cyclesPerUsec();
+    static unsigned long toUsec(unsigned long long cycles) {
+      return (unsigned long) (cycles / cyclesPerUsec());
+    }
+  };
 }
 #endif
 
@@ -0,0 +1,102 @@
+/** Counter based random numbers -*- C++ -*-
+ * @file
+ * @section License
+ *
+ * Galois, a framework to exploit amorphous data-parallelism in irregular
+ * programs.
+ *
+ * Copyright (C) 2012, The University of Texas at Austin. All rights reserved.
+ * UNIVERSITY EXPRESSLY DISCLAIMS ANY AND ALL WARRANTIES CONCERNING THIS
+ * SOFTWARE AND DOCUMENTATION, INCLUDING ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR ANY PARTICULAR PURPOSE, NON-INFRINGEMENT AND WARRANTIES OF
+ * PERFORMANCE, AND ANY WARRANTY THAT MIGHT OTHERWISE ARISE FROM COURSE OF
+ * DEALING OR USAGE OF TRADE.  NO WARRANTY IS EITHER EXPRESS OR IMPLIED WITH
+ * RESPECT TO THE USE OF THE SOFTWARE OR DOCUMENTATION. Under no circumstances
+ * shall University be liable for incidental, special, indirect, direct or
+ * consequential damages or loss of profits, interruption of business, or
+ * related expenses which may arise from use of Software or Documentation,
+ * including but not limited to those resulting from defects in Software and/or
+ * Documentation, or loss or inaccuracy of data of any kind.
+ *
+ * @section Description
+ *
+ * Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2,
+ * 3", SC'11).
+ */
+#ifndef GALOIS_UTIL_PHILOX_H
+#define GALOIS_UTIL_PHILOX_H
+
+#include <stdint.h>
+
+namespace Galois {
+
+/**
+ * Random numbers drawn from the Philox4x32-10 block function, keyed by a
+ * seed and an index.
+ *
+ * The stream of an index is a pure function of (seed, index): items can be
+ * generated by any thread in any order and still get the same numbers, and
+ * there is no state shared between threads. Each block of the stream gives
+ * four 32 bit words.
+ */
+class Philox {
+  uint32_t key[2];
+  uint32_t ctr[4];
+  uint32_t out[4];
+  unsigned used;
+
+  static uint32_t mulhilo(uint32_t a, uint32_t b, uint32_t* hi) {
+    uint64_t p = (uint64_t) a * b;
+    *hi = (uint32_t) (p >> 32);
+    return (uint32_t) p;
+  }
+
+  void block() {
+    uint32_t k0 = key[0], k1 = key[1];
+    uint32_t x[4] = { ctr[0], ctr[1], ctr[2], ctr[3] };
+    for (int r = 0; r < 10; ++r) {
+      uint32_t hi0, hi1;
+      uint32_t lo0 = mulhilo(0xD2511F53, x[0], &hi0);
+      uint32_t lo1 = mulhilo(0xCD9E8D57, x[2], &hi1);
+      uint32_t y[4] = { hi1 ^ x[1] ^ k0, lo1, hi0 ^ x[3] ^ k1, lo0 };
+      for (int i = 0; i < 4; ++i)
+        x[i] = y[i];
+      k0 += 0x9E3779B9;
+      k1 += 0xBB67AE85;
+    }
+    for (int i = 0; i < 4; ++i)
+      out[i] = x[i];
+    if (++ctr[0] == 0)
+      ++ctr[1];
+    used = 0;
+  }
+
+public:
+  /**
+   * Stream of index under seed, starting at its block-th block
+   */
+  Philox(uint64_t seed, uint64_t index, uint64_t block = 0): used(4) {
+    key[0] = (uint32_t) seed;
+    key[1] = (uint32_t) (seed >> 32);
+    ctr[0] = (uint32_t) block;
+    ctr[1] = (uint32_t) (block >> 32);
+    ctr[2] = (uint32_t) index;
+    ctr[3] = (uint32_t) (index >> 32);
+  }
+
+  uint32_t next() {
+    if (used == 4)
+      block();
+    return out[used++];
+  }
+
+  //! Uniform in [0, 1), with 53 random bits
+  double nextDouble() {
+    uint64_t a = next() >> 5, b = next() >> 6;
+    return (a * 67108864.0 + b) * (1.0 / 9007199254740992.0);
+  }
+};
+
+}
+
+#endif
@@ -30,6 +30,7 @@
 
 #include <cstdlib>
 #include <cstdio>
+#include <limits>
 
 #ifdef GALOIS_USE_DMP
 #include "dmp.h"
@@ -45,7 +46,8 @@ void GaloisRuntime::PthreadBarrier::checkResults(int val) {
 
 GaloisRuntime::PthreadBarrier::PthreadBarrier() {
   //uninitialized barriers block a lot of threads to help with debugging
-  int rc = pthread_barrier_init(&bar, 0, ~0);
+  //(glibc rejects counts from INT_MAX up)
+  int rc = pthread_barrier_init(&bar, 0, std::numeric_limits<int>::max() / 2);
   checkResults(rc);
 }
 
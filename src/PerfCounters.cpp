@@ -0,0 +1,161 @@
+/** PAPI counters -*- C++ -*-
+ * @file
+ * @section License
+ *
+ * Galois, a framework to exploit amorphous data-parallelism in irregular
+ * programs.
+ *
+ * Copyright (C) 2012, The University of Texas at Austin. All rights reserved.
+ * UNIVERSITY EXPRESSLY DISCLAIMS ANY AND ALL WARRANTIES CONCERNING THIS
+ * SOFTWARE AND DOCUMENTATION, INCLUDING ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR ANY PARTICULAR PURPOSE, NON-INFRINGEMENT AND WARRANTIES OF
+ * PERFORMANCE, AND ANY WARRANTY THAT MIGHT OTHERWISE ARISE FROM COURSE OF
+ * DEALING OR USAGE OF TRADE.  NO WARRANTY IS EITHER EXPRESS OR IMPLIED WITH
+ * RESPECT TO THE USE OF THE SOFTWARE OR DOCUMENTATION. Under no circumstances
+ * shall University be liable for incidental, special, indirect, direct or
+ * consequential damages or loss of profits, interruption of business, or
+ * related expenses which may arise from use of Software or Documentation,
+ * including but not limited to those resulting from defects in Software and/or
+ * Documentation, or loss or inaccuracy of data of any kind.
+ *
+ * @section Description
+ *
+ * Per-thread PAPI counters read around parallel loops.
+ */
+#include "Galois/Runtime/PerfCounters.h"
+#include "Galois/Galois.h"
+#include "Galois/Runtime/Support.h"
+#include "Galois/Runtime/ll/gio.h"
+
+#ifdef GALOIS_USE_PAPI
+#include <papi.h>
+#endif
+
+using namespace GaloisRuntime;
+
+#ifdef GALOIS_USE_PAPI
+namespace {
+
+unsigned long papiThreadID() {
+  return LL::getTID();
+}
+
+//Initializes PAPI once, from the thread creating the counters
+bool initPAPI() {
+  static bool done = false;
+  static bool ok = false;
+  if (!done) {
+    done = true;
+    int version = PAPI_library_init(PAPI_VER_CURRENT);
+    ok = version == PAPI_VER_CURRENT && PAPI_thread_init(papiThreadID) == PAPI_OK;
+    if (!ok)
+      LL::gWarn("PAPI initialization failed, counters disabled");
+  }
+  return ok;
+}
+
+}
+#endif
+
+PerfCounters::PerfCounters(const std::string& events, const std::string& _loopname)
+  : loopname(_loopname), running(false)
+{
+  for (size_t b = 0, e; b < events.size(); b = e + 1) {
+    e = events.find(',', b);
+    if (e == std::string::npos)
+      e = events.size();
+    if (e > b)
+      names.push_back(events.substr(b, e - b));
+  }
+  if (names.empty())
+    return;
+
+#ifdef GALOIS_USE_PAPI
+  if (!initPAPI())
+    return;
+  for (unsigned i = 0; i < names.size(); ++i) {
+    int code;
+    if (PAPI_event_name_to_code(const_cast<char*>(names[i].c_str()), &code) != PAPI_OK) {
+      LL::gWarn("Unknown PAPI event %s, counters disabled", names[i].c_str());
+      codes.clear();
+      return;
+    }
+    codes.push_back(code);
+  }
+  for (unsigned i = 0; i < locals.size(); ++i)
+    locals.getRemote(i)->totals.resize(codes.size());
+#else
+  LL::gWarn("Built without PAPI, counters disabled");
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+  if (enabled())
+    Galois::on_each(Destroy(this));
+}
+
+void PerfCounters::start() {
+  if (enabled() && !running) {
+    Galois::on_each(Start(this));
+    running = true;
+  }
+}
+
+void PerfCounters::stop() {
+  if (running) {
+    Galois::on_each(Stop(this));
+    running = false;
+  }
+}
+
+long long PerfCounters::total(unsigned i) {
+  long long r = 0;
+  for (unsigned x = 0; x < locals.size(); ++x)
+    r += locals.getRemote(x)->totals[i];
+  return r;
+}
+
+#ifdef GALOIS_USE_PAPI
+void PerfCounters::startLocal() {
+  Local& l = *locals.getLocal();
+  if (l.failed)
+    return;
+  if (l.eventSet == PAPI_NULL) {
+    if (PAPI_create_eventset(&l.eventSet) != PAPI_OK
+        || PAPI_add_events(l.eventSet, &codes[0], codes.size()) != PAPI_OK) {
+      LL::gWarn("Cannot count the PAPI events on thread %u", LL::getTID());
+      destroyLocal();
+      l.failed = true;
+      return;
+    }
+  }
+  if (PAPI_start(l.eventSet) != PAPI_OK)
+    l.failed = true;
+}
+
+void PerfCounters::stopLocal() {
+  Local& l = *locals.getLocal();
+  if (l.failed || l.eventSet == PAPI_NULL)
+    return;
+  std::vector<long long> values(codes.size());
+  if (PAPI_stop(l.eventSet, &values[0]) != PAPI_OK)
+    return;
+  for (unsigned i = 0; i < codes.size(); ++i) {
+    l.totals[i] += values[i];
+    reportStat(loopname, names[i], values[i]);
+  }
+}
+
+void PerfCounters::destroyLocal() {
+  Local& l = *locals.getLocal();
+  if (l.eventSet != PAPI_NULL) {
+    PAPI_cleanup_eventset(l.eventSet);
+    PAPI_destroy_eventset(&l.eventSet);
+    l.eventSet = PAPI_NULL;
+  }
+}
+#else
+void PerfCounters::startLocal() { }
+void PerfCounters::stopLocal() { }
+void PerfCounters::destroyLocal() { }
+#endif
@@ -0,0 +1,105 @@
+/** Progress reporting -*- C++ -*-
+ * @file
+ * @section License
+ *
+ * Galois, a framework to exploit amorphous data-parallelism in irregular
+ * programs.
+ *
+ * Copyright (C) 2012, The University of Texas at Austin. All rights reserved.
+ * UNIVERSITY EXPRESSLY DISCLAIMS ANY AND ALL WARRANTIES CONCERNING THIS
+ * SOFTWARE AND DOCUMENTATION, INCLUDING ANY WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR ANY PARTICULAR PURPOSE, NON-INFRINGEMENT AND WARRANTIES OF
+ * PERFORMANCE, AND ANY WARRANTY THAT MIGHT OTHERWISE ARISE FROM COURSE OF
+ * DEALING OR USAGE OF TRADE.  NO WARRANTY IS EITHER EXPRESS OR IMPLIED WITH
+ * RESPECT TO THE USE OF THE SOFTWARE OR DOCUMENTATION. Under no circumstances
+ * shall University be liable for incidental, special, indirect, direct or
+ * consequential damages or loss of profits, interruption of business, or
+ * related expenses which may arise from use of Software or Documentation,
+ * including but not limited to those resulting from defects in Software and/or
+ * Documentation, or loss or inaccuracy of data of any kind.
+ *
+ * @section Description
+ *
+ * Progress of a parallel loop, printed by a reporter thread.
+ */
+#include "Galois/Runtime/Progress.h"
+
+#include <cstdio>
+#include <ctime>
+
+using namespace GaloisRuntime;
+
+Progress::Progress(const std::string& _label, unsigned _interval)
+  : label(_label), interval(_interval), total(0), printed(~0UL),
+    active(false), quit(false), started(false)
+{
+  pthread_mutex_init(&mutex, 0);
+  pthread_cond_init(&wake, 0);
+}
+
+Progress::~Progress() {
+  if (started) {
+    pthread_mutex_lock(&mutex);
+    quit = true;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(thread, 0);
+  }
+  pthread_cond_destroy(&wake);
+  pthread_mutex_destroy(&mutex);
+}
+
+unsigned long Progress::sum() {
+  unsigned long r = 0;
+  for (unsigned x = 0; x < counts.size(); ++x)
+    r += __atomic_load_n(&counts.getRemote(x)->n, __ATOMIC_RELAXED);
+  return r;
+}
+
+void Progress::print(unsigned long done) {
+  fprintf(stderr, "\r%s %lu / %lu", label.c_str(), done, total);
+  fflush(stderr);
+  printed = done;
+}
+
+void* Progress::reporter(void* arg) {
+  Progress& p = *static_cast<Progress*>(arg);
+  pthread_mutex_lock(&p.mutex);
+  while (!p.quit) {
+    timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_nsec += (p.interval % 1000) * 1000000L;
+    until.tv_sec += p.interval / 1000 + until.tv_nsec / 1000000000L;
+    until.tv_nsec %= 1000000000L;
+    pthread_cond_timedwait(&p.wake, &p.mutex, &until);
+    if (p.active && !p.quit) {
+      unsigned long done = p.sum();
+      if (done != p.printed)
+        p.print(done);
+    }
+  }
+  pthread_mutex_unlock(&p.mutex);
+  return 0;
+}
+
+void Progress::start(unsigned long _total) {
+  for (unsigned x = 0; x < counts.size(); ++x)
+    counts.getRemote(x)->n = 0;
+  pthread_mutex_lock(&mutex);
+  total = _total;
+  printed = ~0UL;
+  active = true;
+  pthread_mutex_unlock(&mutex);
+  if (!started)
+    started = pthread_create(&thread, 0, reporter, this) == 0;
+}
+
+void Progress::stop() {
+  pthread_mutex_lock(&mutex);
+  if (active) {
+    active = false;
+    print(sum());
+    fputc('\n', stderr);
+  }
+  pthread_mutex_unlock(&mutex);
+}
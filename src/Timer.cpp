@@ -24,6 +24,7 @@
 
 // This is linux/bsd specific
 #include <sys/time.h>
+#include <time.h>
 
 namespace Galois {
 
@@ -91,4 +92,31 @@ TimeAccumulator& TimeAccumulator::operator+=(const TimeAccumulator& rhs) {
   return *this;
 }
 
+unsigned long long readClock() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+//! Counts time stamp counter ticks over 20ms of the monotonic clock
+static double measureTSC() {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned long long c0 = readClock();
+  unsigned long long t0 = readTSC();
+  unsigned long long c1;
+  do {
+    c1 = readClock();
+  } while (c1 - c0 < 20000000ULL);
+  unsigned long long t1 = readTSC();
+  return (t1 - t0) * 1000.0 / (c1 - c0);
+#else
+  return 1000.0;
+#endif
+}
+
+double TSCTimer::cyclesPerUsec() {
+  static double rate = measureTSC();
+  return rate;
+}
+
 }
@@ -0,0 +1,182 @@
+/*
+ * Compares the mixed precision simd and group walks with their double
+ * versions (-precision=mixed against -precision=double) on one Plummer
+ * input, and both with a direct sum. Prints the error and the throughput
+ * of each path; run as mixed-precision [bodies [tol]] to measure other
+ * sizes.
+ */
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <stack>
+#include <cstdlib>
+#include <cmath>
+#include <strings.h>
+#include <sys/time.h>
+
+#include "Galois/Galois.h"
+#include "Galois/Statistic.h"
+#include "Galois/Runtime/Progress.h"
+
+#include "config.h"
+#include "NodeArena.h"
+#include "BoundingBox.h"
+#include "f_BuildOctree.h"
+#include "f_ComputeCenterOfMass.h"
+#include "LinearOctree.h"
+#include "f_SimdComputeForces.h"
+#include "f_GroupComputeForces.h"
+#include "utilities.h"
+
+using namespace Barneshut;
+
+// float positions relative to the body or group carry about 1e-7 of the
+// distance, and the sums are kept in double
+static const double MaxMixedError = 1e-5;
+// bodies summed directly, for the approximation error
+static const unsigned Sample = 200;
+
+static void check(const char* func, bool ok, const char* what) {
+  if (!ok) {
+    std::cerr << func << ": " << what << "\n";
+    abort();
+  }
+}
+
+static double seconds() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static double relError(Point a, Point ref) {
+  Point d(a.x - ref.x, a.y - ref.y, a.z - ref.z);
+  return sqrt(d.dist_sq() / ref.dist_sq());
+}
+
+struct Result {
+  std::vector<Point> acc;
+  double seconds;
+};
+
+template<typename F>
+static void runBodies(Bodies& bodies, F f, GaloisRuntime::Progress* comp, Result& r) {
+  std::vector<Body*> order(bodies.size());
+  for (size_t i = 0; i < bodies.size(); ++i) {
+    order[i] = &bodies[i];
+    bodies[i].acc = Point();
+  }
+  comp->start(order.size());
+  double start = seconds();
+  Galois::for_each(order.begin(), order.end(), f);
+  r.seconds = seconds() - start;
+  comp->stop();
+  r.acc.resize(bodies.size());
+  for (size_t i = 0; i < bodies.size(); ++i)
+    r.acc[i] = bodies[i].acc;
+}
+
+template<typename F>
+static void runGroups(Bodies& bodies, std::vector<BodyGroup>& groups, F f, GaloisRuntime::Progress* comp, Result& r) {
+  for (size_t i = 0; i < bodies.size(); ++i)
+    bodies[i].acc = Point();
+  comp->start(groups.size());
+  double start = seconds();
+  Galois::for_each(groups.begin(), groups.end(), f);
+  r.seconds = seconds() - start;
+  comp->stop();
+  r.acc.resize(bodies.size());
+  for (size_t i = 0; i < bodies.size(); ++i)
+    r.acc[i] = bodies[i].acc;
+}
+
+static Point directSum(Bodies& bodies, size_t i, double epssq) {
+  Point acc;
+  for (size_t j = 0; j < bodies.size(); ++j) {
+    if (j == i)
+      continue;
+    Point d(bodies[j].pos.x - bodies[i].pos.x, bodies[j].pos.y - bodies[i].pos.y, bodies[j].pos.z - bodies[i].pos.z);
+    double r2 = d.dist_sq() + epssq;
+    double f = bodies[j].mass / (r2 * sqrt(r2));
+    acc.x += d.x * f; acc.y += d.y * f; acc.z += d.z * f;
+  }
+  return acc;
+}
+
+/**
+ * Prints the throughput of r and its error against the direct sum and, when
+ * given, against ref. Returns the worst error against ref
+ */
+static double report(const char* name, const Result& r, const Result* ref, const std::vector<Point>& direct) {
+  size_t n = r.acc.size();
+  double approx = 0.0;
+  for (unsigned s = 0; s < Sample; ++s)
+    approx += relError(r.acc[s * n / Sample], direct[s]);
+  std::cout << std::setw(14) << std::left << name << std::right << std::fixed << std::setprecision(0)
+    << std::setw(10) << n / r.seconds << " bodies/s" << std::scientific << std::setprecision(2)
+    << "  vs direct sum: mean " << approx / Sample;
+
+  double mean = 0.0, worst = 0.0;
+  if (ref) {
+    for (size_t i = 0; i < n; ++i) {
+      double e = relError(r.acc[i], ref->acc[i]);
+      mean += e;
+      worst = std::max(worst, e);
+    }
+    std::cout << "  vs double: mean " << mean / n << " max " << worst;
+  }
+  std::cout << "\n";
+  return worst;
+}
+
+int main(int argc, char** argv) {
+  int nbodies = argc > 1 ? atoi(argv[1]) : 20000;
+  double tol = argc > 2 ? atof(argv[2]) : 0.5;
+  Galois::setActiveThreads(4);
+
+  Bodies bodies;
+  generateInput(bodies, nbodies, 7);
+  BoundingBox box;
+  for (size_t i = 0; i < bodies.size(); ++i)
+    box.merge(bodies[i].pos);
+  NodeArena arena;
+  OctreeInternal* top = arena.create<OctreeInternal>(box.center());
+  BuildOctree build(top, box.radius(), &arena);
+  for (size_t i = 0; i < bodies.size(); ++i)
+    build.insert(&bodies[i], top, box.radius());
+  ComputeCenterOfMass summarize(top);
+  summarize();
+
+  Config config(tol);
+  LinearOctree linear;
+  linear.build(top, box.diameter() * box.diameter() * config.itolsq, &bodies[0]);
+  std::vector<BodyGroup> groups;
+  GroupCollector(16, groups)(top);
+
+  std::vector<Point> direct(Sample);
+  for (unsigned s = 0; s < Sample; ++s)
+    direct[s] = directSum(bodies, s * bodies.size() / Sample, config.epssq);
+
+  const char* kernel_name;
+  ForceKernel kernel = selectForceKernel(&kernel_name);
+  MixedForceKernel mixed_kernel = selectMixedForceKernel();
+  std::cout << nbodies << " bodies, tol " << tol << ", " << kernel_name << " kernels\n";
+
+  Galois::CycleStatistic traversal("TraversalTime");
+  GaloisRuntime::Progress comp("forces");
+  InteractionLists lists;
+  MixedInteractionLists mixed_lists;
+  Result simd, mixedSimd, group, mixedGroup;
+  runBodies(bodies, SimdComputeForces(&linear, &lists, kernel, 0.0, config.epssq, &traversal, &comp), &comp, simd);
+  runBodies(bodies, MixedSimdComputeForces(&linear, &mixed_lists, mixed_kernel, 0.0, config.epssq, &traversal, &comp), &comp, mixedSimd);
+  runGroups(bodies, groups, GroupComputeForces(&linear, &lists, kernel, 0.0, config.epssq, &traversal, &comp), &comp, group);
+  runGroups(bodies, groups, MixedGroupComputeForces(&linear, &mixed_lists, mixed_kernel, 0.0, config.epssq, &traversal, &comp), &comp, mixedGroup);
+
+  report("simd double", simd, NULL, direct);
+  double simdError = report("simd mixed", mixedSimd, &simd, direct);
+  report("group double", group, NULL, direct);
+  double groupError = report("group mixed", mixedGroup, &group, direct);
+  check(__FUNCTION__, simdError <= MaxMixedError, "mixed simd walk too far from double");
+  check(__FUNCTION__, groupError <= MaxMixedError, "mixed group walk too far from double");
+  return 0;
+}
@@ -0,0 +1,109 @@
+#include <iostream>
+#include <vector>
+#include <stack>
+#include <cstdlib>
+#include <cmath>
+#include <strings.h>
+
+#include "Galois/Galois.h"
+
+#include "config.h"
+#include "NodeArena.h"
+#include "BoundingBox.h"
+#include "f_BuildOctree.h"
+#include "f_MortonBuildOctree.h"
+#include "f_ComputeCenterOfMass.h"
+#include "f_CleanComputeForces.h"
+#include "utilities.h"
+
+using namespace Barneshut;
+
+// summaries are the same sums in the same order, so only rounding differs
+static const double Tolerance = 1e-12;
+
+static void check(const char* func, bool ok, const char* what) {
+  if (!ok) {
+    std::cerr << func << ": " << what << "\n";
+    abort();
+  }
+}
+
+static bool close(double a, double b, double scale) {
+  return fabs(a - b) <= Tolerance * scale;
+}
+
+//! Same cells, children and summaries
+static void compare(Octree* a, Octree* b, double radius) {
+  check(__FUNCTION__, (a == NULL) == (b == NULL), "child missing");
+  if (a == NULL)
+    return;
+  check(__FUNCTION__, a->isLeaf() == b->isLeaf(), "cell against body");
+  if (a->isLeaf()) {
+    check(__FUNCTION__, a == b, "different bodies");
+    return;
+  }
+  OctreeInternal* x = static_cast<OctreeInternal*>(a);
+  OctreeInternal* y = static_cast<OctreeInternal*>(b);
+  check(__FUNCTION__, x->size == y->size && x->nbodies == y->nbodies, "different subtrees");
+  check(__FUNCTION__, close(x->mass, y->mass, x->mass), "different masses");
+  for (int i = 0; i < 3; ++i)
+    check(__FUNCTION__, close(x->pos[i], y->pos[i], radius), "different centers of mass");
+  for (int i = 0; i < 8; ++i)
+    compare(x->child[i], y->child[i], radius);
+}
+
+static void forces(OctreeInternal* top, const BoundingBox& box, Bodies& bodies, std::vector<Point>& acc) {
+  Config config(0.5);
+  CleanComputeForces ccf(top, box.diameter(), config.itolsq, config.dthf, config.epssq);
+  acc.resize(bodies.size());
+  for (size_t i = 0; i < bodies.size(); ++i) {
+    bodies[i].acc = Point();
+    ccf.iterate(bodies[i], ccf.root_dsq);
+    acc[i] = bodies[i].acc;
+  }
+}
+
+static void test(int nbodies, int duplicates) {
+  Bodies bodies;
+  generateInput(bodies, nbodies, 7);
+  // bodies closer than the finest Morton cell
+  for (int i = 0; i < duplicates; ++i) {
+    Body b = bodies[i];
+    b.pos.x += 1e-9;
+    bodies.push_back(b);
+  }
+  BoundingBox box;
+  for (size_t i = 0; i < bodies.size(); ++i)
+    box.merge(bodies[i].pos);
+
+  NodeArena insertArena, mortonArena;
+  OctreeInternal* inserted = insertArena.create<OctreeInternal>(box.center());
+  BuildOctree build(inserted, box.radius(), &insertArena);
+  for (size_t i = 0; i < bodies.size(); ++i)
+    build.insert(&bodies[i], inserted, box.radius());
+  MortonBuildOctree morton;
+  OctreeInternal* sorted = morton(bodies, box, &mortonArena);
+
+  ComputeCenterOfMass summarizeInserted(inserted);
+  summarizeInserted();
+  ComputeCenterOfMass summarizeSorted(sorted);
+  summarizeSorted();
+  check(__FUNCTION__, sorted->nbodies == bodies.size(), "bodies lost");
+  compare(inserted, sorted, box.radius());
+
+  std::vector<Point> a, b;
+  forces(inserted, box, bodies, a);
+  forces(sorted, box, bodies, b);
+  for (size_t i = 0; i < bodies.size(); ++i)
+    for (int k = 0; k < 3; ++k)
+      check(__FUNCTION__, close(a[i][k], b[i][k], fabs(a[i][k]) + 1.0), "different forces");
+}
+
+int main() {
+  Galois::setActiveThreads(4);
+  test(1, 0);
+  test(2, 0);
+  test(20000, 0);
+  test(20000, 100);
+  return 0;
+}
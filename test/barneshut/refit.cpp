@@ -0,0 +1,104 @@
+#include <iostream>
+#include <vector>
+#include <stack>
+#include <cstdlib>
+#include <cmath>
+#include <strings.h>
+
+#include "Galois/Galois.h"
+
+#include "config.h"
+#include "NodeArena.h"
+#include "BoundingBox.h"
+#include "f_BuildOctree.h"
+#include "f_RefitOctree.h"
+#include "f_ComputeCenterOfMass.h"
+#include "f_CleanComputeForces.h"
+#include "utilities.h"
+
+using namespace Barneshut;
+
+// a refit tree may keep cells a fresh build would not make (a cell around
+// a single body, until the next refit drops it), so sums can be rounded in
+// a different order
+static const double Tolerance = 1e-12;
+
+static void check(const char* func, bool ok, const char* what) {
+  if (!ok) {
+    std::cerr << func << ": " << what << "\n";
+    abort();
+  }
+}
+
+static OctreeInternal* build(Bodies& bodies, const BoundingBox& cube, NodeArena* arena) {
+  OctreeInternal* top = arena->create<OctreeInternal>(cube.center());
+  BuildOctree b(top, cube.radius(), arena);
+  for (size_t i = 0; i < bodies.size(); ++i)
+    b.insert(&bodies[i], top, cube.radius());
+  return top;
+}
+
+static void forces(OctreeInternal* top, const BoundingBox& cube, Bodies& bodies, std::vector<Point>& acc) {
+  ComputeCenterOfMass summarize(top);
+  summarize();
+  Config config(0.5);
+  CleanComputeForces ccf(top, cube.diameter(), config.itolsq, config.dthf, config.epssq);
+  acc.resize(bodies.size());
+  for (size_t i = 0; i < bodies.size(); ++i) {
+    bodies[i].acc = Point();
+    ccf.iterate(bodies[i], ccf.root_dsq);
+    acc[i] = bodies[i].acc;
+  }
+}
+
+int main() {
+  Galois::setActiveThreads(4);
+  Bodies bodies;
+  generateInput(bodies, 20000, 7);
+
+  NodeArena treeArena;
+  RefitOctree refitter(&treeArena);
+  unsigned refits = 0, rebuilds = 0;
+  size_t moves = 0;
+  for (int step = 0; step < 12; ++step) {
+    BoundingBox box;
+    for (size_t i = 0; i < bodies.size(); ++i)
+      box.merge(bodies[i].pos);
+
+    // as the app does, rebuilding once the tree has grown by 2%
+    OctreeInternal* top;
+    if (refitter(box, 0.5, 1.02)) {
+      top = refitter.top();
+      moves += refitter.moves();
+      ++refits;
+    } else {
+      box.grow(box.radius() * 0.125);
+      treeArena.reset();
+      top = build(bodies, box, &treeArena);
+      refitter.built(top, box);
+      ++rebuilds;
+    }
+    BoundingBox cube = refitter.cube();
+
+    NodeArena freshArena;
+    OctreeInternal* fresh = build(bodies, cube, &freshArena);
+    std::vector<Point> a, b;
+    forces(top, cube, bodies, a);
+    forces(fresh, cube, bodies, b);
+    check(__FUNCTION__, top->nbodies == bodies.size() && fresh->nbodies == bodies.size(), "bodies lost");
+    for (size_t i = 0; i < bodies.size(); ++i) {
+      double norm = sqrt(b[i].dist_sq());
+      for (int k = 0; k < 3; ++k) {
+        check(__FUNCTION__, fabs(a[i][k] - b[i][k]) <= Tolerance * norm, "refit forces differ from a fresh build");
+      }
+    }
+
+    // drift, far enough for bodies to change cells
+    for (size_t i = 0; i < bodies.size(); ++i)
+      for (int k = 0; k < 3; ++k)
+        bodies[i].pos[k] += bodies[i].vel[k] * 0.05;
+  }
+  // both paths, and a rebuild after refits, were taken
+  check(__FUNCTION__, refits > 0 && rebuilds > 1 && moves > 0, "refit or rebuild not exercised");
+  return 0;
+}
@@ -0,0 +1,33 @@
+# Runs barneshut for 4 time steps with a checkpoint every 2, and for 2 time
+# steps then 2 more restarted from the checkpoint, and checks that both end
+# on the same bytes. A checkpoint drops the kept octree (-refit, -levels),
+# so the uninterrupted run builds a new one there too.
+#
+#   cmake -DBARNESHUT=<binary> -P restart.cmake
+
+if(NOT BARNESHUT)
+  message(FATAL_ERROR "BARNESHUT is not set")
+endif()
+
+set(common -n 2000 -seed 4 -tol 0.5)
+
+function(run)
+  execute_process(COMMAND ${BARNESHUT} ${ARGN} RESULT_VARIABLE result OUTPUT_QUIET ERROR_QUIET)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "barneshut ${ARGN} failed: ${result}")
+  endif()
+endfunction()
+
+# the variant name, then its options
+foreach(variant "clean" "soa;-soa" "simd;-forces=simd;-sort" "levels;-levels;3" "refit;-refit;0.6")
+  list(GET variant 0 name)
+  list(REMOVE_AT variant 0)
+  run(${common} ${variant} -ts 4 -checkpoint-every 2 -checkpoint ${name}-whole.snap)
+  run(${common} ${variant} -ts 2 -checkpoint-every 2 -checkpoint ${name}-half.snap)
+  run(-restart ${name}-half.snap -tol 0.5 ${variant} -ts 2 -checkpoint-every 2 -checkpoint ${name}-restarted.snap)
+  execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${name}-whole.snap ${name}-restarted.snap RESULT_VARIABLE differ)
+  if(differ)
+    message(FATAL_ERROR "${name}: the restarted run differs from the uninterrupted one")
+  endif()
+  file(REMOVE ${name}-whole.snap ${name}-half.snap ${name}-restarted.snap)
+endforeach()
@@ -47,7 +47,9 @@ struct checker {
   }
 };
 
-#define GALOIS_WLCOMPILECHECK(name) checker<name<> > ck_##name;
+// instantiates every worklist at compile time; constructing them before
+// the runtime is up, as globals did, is not supported
+#define GALOIS_WLCOMPILECHECK(name) void ck_##name() { checker<name<> > ck; }
 #include "Galois/Runtime/WorkList.h"
 
 int main() {
@@ -6,12 +6,6 @@
 
 #include <iostream>
 
-GaloisRuntime::MCSBarrier mbarrier;
-GaloisRuntime::PthreadBarrier pbarrier;
-GaloisRuntime::FastBarrier fbarrier;
-GaloisRuntime::FasterBarrier ffbarrier;
-GaloisRuntime::TopoBarrier tbarrier;
-
 template<typename BarTy>
 struct test {
   BarTy& b;
@@ -36,6 +30,13 @@ void testf(T& b, const char* str) {
 }
 
 int main() {
+  // not globals: barriers need the runtime, which is not up during static
+  // initialization
+  GaloisRuntime::MCSBarrier mbarrier;
+  GaloisRuntime::PthreadBarrier pbarrier;
+  GaloisRuntime::FastBarrier fbarrier;
+  GaloisRuntime::FasterBarrier ffbarrier;
+  GaloisRuntime::TopoBarrier tbarrier;
 
   unsigned M = GaloisRuntime::LL::getMaxThreads();
 
@@ -0,0 +1,60 @@
+#include "Galois/Galois.h"
+#include "Galois/Runtime/PerfCounters.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <string>
+
+static void check(const char* func, bool ok, const char* what) {
+  if (!ok) {
+    std::cerr << func << ": " << what << "\n";
+    abort();
+  }
+}
+
+struct Work {
+  void operator()(unsigned, unsigned) {
+    volatile double x = 1.0;
+    for (int i = 0; i < 100000; ++i)
+      x = x * 1.0000001 + 1e-9;
+  }
+};
+
+//! Counters that could not be set up do nothing, whatever the build
+static void testDisabled() {
+  const char* lists[] = { "", ",", "NOT_AN_EVENT", "PAPI_TOT_INS,NOT_AN_EVENT" };
+  for (unsigned i = 0; i < sizeof(lists) / sizeof(*lists); ++i) {
+    GaloisRuntime::PerfCounters counters(lists[i], "Test");
+    check(__FUNCTION__, !counters.enabled(), "bad event list enabled the counters");
+    check(__FUNCTION__, counters.size() == 0, "disabled counters have events");
+    counters.start();
+    Galois::on_each(Work());
+    counters.stop();
+    counters.stop();
+  }
+}
+
+//! Counts instructions, when this build and machine can
+static void testCount() {
+  GaloisRuntime::PerfCounters counters("PAPI_TOT_INS", "Test");
+  if (!counters.enabled()) {
+    std::cout << "PAPI_TOT_INS not available, skipping the count\n";
+    return;
+  }
+  check(__FUNCTION__, counters.size() == 1 && counters.name(0) == "PAPI_TOT_INS", "wrong events");
+  counters.start();
+  Galois::on_each(Work());
+  counters.stop();
+  long long first = counters.total(0);
+  counters.start();
+  Galois::on_each(Work());
+  counters.stop();
+  check(__FUNCTION__, counters.total(0) > first, "totals did not grow");
+}
+
+int main() {
+  Galois::setActiveThreads(4);
+  testDisabled();
+  testCount();
+  return 0;
+}
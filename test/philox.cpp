@@ -0,0 +1,84 @@
+#include "Galois/util/Philox.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <stdint.h>
+
+static void check(const char* func, bool ok, const char* what) {
+  if (!ok) {
+    std::cerr << func << ": " << what << "\n";
+    abort();
+  }
+}
+
+static uint64_t join(uint32_t lo, uint32_t hi) {
+  return lo | (uint64_t) hi << 32;
+}
+
+//! Known answers of Philox4x32-10 from the Random123 distribution
+static void testKnownAnswers() {
+  struct Vector {
+    uint32_t ctr[4];
+    uint32_t key[2];
+    uint32_t out[4];
+  } vectors[] = {
+    { { 0x00000000, 0x00000000, 0x00000000, 0x00000000 },
+      { 0x00000000, 0x00000000 },
+      { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 } },
+    { { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff },
+      { 0xffffffff, 0xffffffff },
+      { 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd } },
+    { { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 },
+      { 0xa4093822, 0x299f31d0 },
+      { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 } },
+  };
+  for (unsigned v = 0; v < sizeof(vectors) / sizeof(*vectors); ++v) {
+    Vector& t = vectors[v];
+    Galois::Philox p(join(t.key[0], t.key[1]), join(t.ctr[2], t.ctr[3]), join(t.ctr[0], t.ctr[1]));
+    for (int i = 0; i < 4; ++i)
+      check(__FUNCTION__, p.next() == t.out[i], "wrong block output");
+  }
+}
+
+//! Starting at a block is the same as drawing up to it
+static void testBlocks() {
+  Galois::Philox whole(42, 7);
+  for (uint64_t block = 0; block < 5; ++block) {
+    Galois::Philox part(42, 7, block);
+    for (int i = 0; i < 4; ++i)
+      check(__FUNCTION__, whole.next() == part.next(), "block does not match the stream");
+  }
+  // the block counter carries into its high word
+  Galois::Philox low(42, 7, 0xffffffffULL);
+  Galois::Philox high(42, 7, 0x100000000ULL);
+  for (int i = 0; i < 4; ++i)
+    low.next();
+  for (int i = 0; i < 4; ++i)
+    check(__FUNCTION__, low.next() == high.next(), "counter did not carry");
+}
+
+static void testStreams() {
+  Galois::Philox a(1, 0), b(1, 1), c(2, 0), d(1, 0);
+  bool diffIndex = false, diffSeed = false;
+  for (int i = 0; i < 8; ++i) {
+    uint32_t x = a.next();
+    diffIndex |= x != b.next();
+    diffSeed |= x != c.next();
+    check(__FUNCTION__, x == d.next(), "same seed and index differ");
+  }
+  check(__FUNCTION__, diffIndex, "indices share a stream");
+  check(__FUNCTION__, diffSeed, "seeds share a stream");
+
+  Galois::Philox e(3, 3);
+  for (int i = 0; i < 100000; ++i) {
+    double x = e.nextDouble();
+    check(__FUNCTION__, x >= 0.0 && x < 1.0, "double out of range");
+  }
+}
+
+int main() {
+  testKnownAnswers();
+  testBlocks();
+  testStreams();
+  return 0;
+}
@@ -0,0 +1,75 @@
+#include "Galois/Galois.h"
+#include "Galois/Runtime/Progress.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+static void check(const char* func, bool ok, const std::string& what) {
+  if (!ok) {
+    std::cerr << func << ": " << what << "\n";
+    abort();
+  }
+}
+
+struct Ticks {
+  GaloisRuntime::Progress* p;
+  unsigned n;
+  Ticks(GaloisRuntime::Progress* _p, unsigned _n): p(_p), n(_n) { }
+  void operator()(unsigned tid, unsigned num) {
+    unsigned end = n * (tid + 1) / num;
+    for (unsigned i = n * tid / num; i < end; ++i)
+      p->tick();
+  }
+};
+
+int main() {
+  Galois::setActiveThreads(4);
+  const char* file = "progress.out";
+
+  // send stderr to a file for a while
+  fflush(stderr);
+  int saved = dup(2);
+  if (!freopen(file, "w", stderr))
+    abort();
+
+  {
+    GaloisRuntime::Progress p("loop", 1);
+    for (unsigned round = 0; round < 3; ++round) {
+      unsigned n = 1000 * (round + 1);
+      p.start(n);
+      Galois::on_each(Ticks(&p, n));
+      // let the reporter wake up at least once
+      usleep(20000);
+      check(__FUNCTION__, p.count() == n, "ticks lost");
+      p.stop();
+    }
+    // stopping again prints nothing more
+    p.stop();
+  }
+
+  fflush(stderr);
+  dup2(saved, 2);
+  close(saved);
+
+  std::ifstream in(file);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  std::string out = ss.str();
+  unlink(file);
+
+  // every loop ends on its own line with its final count
+  check(__FUNCTION__, !out.empty() && out[out.size() - 1] == '\n', "output does not end the line");
+  size_t lines = 0;
+  for (size_t i = 0; i < out.size(); ++i)
+    lines += out[i] == '\n';
+  check(__FUNCTION__, lines == 3, "expected 3 lines, got " + out);
+  check(__FUNCTION__, out.find("loop 1000 / 1000\n") != std::string::npos, "missing first count in " + out);
+  check(__FUNCTION__, out.find("loop 2000 / 2000\n") != std::string::npos, "missing second count in " + out);
+  check(__FUNCTION__, out.find("loop 3000 / 3000\n") != std::string::npos, "missing third count in " + out);
+  return 0;
+}
@@ -0,0 +1,115 @@
+#include "Galois/SpatialSort.h"
+
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+struct Elem {
+  double pos[3];
+  uint64_t key;
+  unsigned id;
+  std::string name; // not trivially copyable
+};
+
+struct Coords {
+  double operator()(const Elem& e, int axis) const {
+    return e.pos[axis];
+  }
+};
+
+struct ElemKey {
+  uint64_t operator()(const Elem& e) const {
+    return e.key;
+  }
+};
+
+static void check(const char* func, bool ok, const char* what) {
+  if (!ok) {
+    std::cerr << func << ": " << what << "\n";
+    abort();
+  }
+}
+
+//! Morton key of p, one bit at a time
+static uint64_t naiveKey(const double* p, const double* lo, double scale) {
+  uint64_t key = 0;
+  for (int a = 0; a < 3; ++a) {
+    uint64_t q = static_cast<uint64_t>((p[a] - lo[a]) * scale);
+    for (int bit = 0; bit < 21; ++bit)
+      key |= ((q >> bit) & 1) << (3 * bit + a);
+  }
+  return key;
+}
+
+static std::vector<Elem> makeInput(unsigned n, unsigned buckets) {
+  std::vector<Elem> v(n);
+  for (unsigned i = 0; i < n; ++i) {
+    for (int a = 0; a < 3; ++a)
+      v[i].pos[a] = rand() / (double) RAND_MAX * 10.0 - 5.0;
+    v[i].key = rand() % buckets;
+    v[i].id = i;
+    v[i].name = "elem";
+  }
+  return v;
+}
+
+//! Every id once, and the names copied along
+static void checkPermutation(const std::vector<Elem>& v) {
+  std::vector<unsigned> ids;
+  for (unsigned i = 0; i < v.size(); ++i) {
+    ids.push_back(v[i].id);
+    check(__FUNCTION__, v[i].name == "elem", "element not copied");
+  }
+  std::sort(ids.begin(), ids.end());
+  for (unsigned i = 0; i < ids.size(); ++i)
+    check(__FUNCTION__, ids[i] == i, "not a permutation");
+}
+
+static void testSortByKey(Galois::SpatialSorter& sorter, unsigned n) {
+  // few distinct keys, so stability is exercised
+  std::vector<Elem> v = makeInput(n, 97);
+  sorter.sortByKey(v.begin(), v.end(), ElemKey());
+  checkPermutation(v);
+  for (unsigned i = 1; i < n; ++i) {
+    check(__FUNCTION__, v[i - 1].key <= v[i].key, "keys out of order");
+    if (v[i - 1].key == v[i].key)
+      check(__FUNCTION__, v[i - 1].id < v[i].id, "equal keys reordered");
+    check(__FUNCTION__, sorter.sortedKeys()[i] == v[i].key, "sortedKeys does not match");
+  }
+}
+
+static void testMorton(Galois::SpatialSorter& sorter, unsigned n) {
+  std::vector<Elem> v = makeInput(n, 1);
+  sorter(v.begin(), v.end(), Coords());
+  checkPermutation(v);
+
+  double lo[3], hi[3], extent = 0.0;
+  for (int a = 0; a < 3; ++a) {
+    lo[a] = hi[a] = v[0].pos[a];
+    for (unsigned i = 1; i < n; ++i) {
+      lo[a] = std::min(lo[a], v[i].pos[a]);
+      hi[a] = std::max(hi[a], v[i].pos[a]);
+    }
+    extent = std::max(extent, hi[a] - lo[a]);
+  }
+  double scale = ((1 << 21) - 1) / extent;
+  for (unsigned i = 1; i < n; ++i)
+    check(__FUNCTION__, naiveKey(v[i - 1].pos, lo, scale) <= naiveKey(v[i].pos, lo, scale), "not in Morton order");
+}
+
+int main() {
+  Galois::setActiveThreads(4);
+  srand(1);
+  Galois::SpatialSorter sorter;
+  // the same sorter across sizes, growing and shrinking its buffers
+  unsigned sizes[] = { 0, 1, 2, 1000, 100000, 5000 };
+  for (unsigned i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+    testSortByKey(sorter, sizes[i]);
+    if (sizes[i] > 0)
+      testMorton(sorter, sizes[i]);
+  }
+  return 0;
+}